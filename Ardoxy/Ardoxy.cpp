@@ -5,93 +5,223 @@
 
 #include <Arduino.h>
 #include <Ardoxy.h>
-#include <SoftwareSerial.h>
-
+#include <ArdoxyParser.h>
+
+// Command names in flash, in the order of ARDOXY_CMD_* (the first three characters identify a command)
+static const char commandNames[ARDOXY_CMD_OTHER][6] PROGMEM = {"#VERS", "MSR", "TMP", "SEQ", "MEA", "REA", "RMR"};
+
+Ardoxy* Ardoxy::instances = 0;
+bool Ardoxy::inService = false;
+
+// Count an event in the statistics (nothing with ARDOXY_STATS 0)
+#if ARDOXY_STATS
+#define ARDOXY_COUNT(counter) stats.counter++
+#else
+#define ARDOXY_COUNT(counter)
+#endif
+
+#if ARDOXY_LOW_RAM
+char Ardoxy::measCommand[ARDOXY_COMMAND_SIZE];
+ArdoxyParser Ardoxy::parser;
+long Ardoxy::fields[ARDOXY_MAX_FIELDS];
+ArdoxyResult Ardoxy::lastReading;
+#endif
+
+// Add the instance to the list served by serviceAll()
+void Ardoxy::link()
+{
+  nextInstance = instances;
+  instances = this;
+}
 
-void Ardoxy::begin()
+Ardoxy::~Ardoxy()
 {
-  if (hwStream)
-  {
-    hwStream->begin(19200);
-    delay(3000);
-    while(hwStream->available()>0){
-      char t = hwStream->read();
-      delay(2);
+  for(Ardoxy** p = &instances; *p; p = &(*p)->nextInstance){
+    if(*p == this){
+      *p = nextInstance;
+      break;
     }
-    hwStream->write("MSR 1\r");
-    delay(300);
-    if(hwStream->available()){
-      Serial.println("Hardware Serial Connection Established, Baudrate 19200");
-      while(hwStream->available()>0){
-        char t = hwStream->read();
-        delay(2);
+  }
+}
+
+// Begin function: open the serial port and find the baud rate of the FireSting (19200 or 115200)
+// The remembered baud rate (last successful connection or knownBaud) is probed first. Each probe is a #VERS
+// command that also returns the firmware version; probes alternate between both rates until one is answered
+// or ARDOXY_CONNECT_TIMEOUT has elapsed (e.g. while the FireSting is still booting). A Stream opened by the
+// caller is probed at its own baud rate only. The connection is reported on Serial until it has been
+// established once; later reconnects (recover()) are silent and only counted in the statistics.
+// Returns:
+// 1 when the connection is established
+// 0 when the FireSting did not answer
+int Ardoxy::begin(long knownBaud)
+{
+  if(knownBaud == 19200 || knownBaud == 115200){
+    baud = knownBaud;
+  }
+  long tryBaud = baud;
+  unsigned long connectStart = millis();
+  if(connected){
+    ARDOXY_COUNT(reconnects);
+  }
+#if ARDOXY_COMP_CACHE
+  compValid = false;                                      // the FireSting may have been restarted
+#endif
+
+  do {
+    openPort(tryBaud);
+    int reply = getVer();
+    if(reply != 0 && reply != 9){
+      if(!connected){
+        Serial.print(F("Serial Connection Established, Baudrate "));
+        Serial.println(tryBaud);
+        Serial.print(F("Firmware Version: "));
+        Serial.println(reply);
       }
-      ver = getVer();
-      Serial.print("Firmware Version: ");
-      Serial.println(ver);
+      connectDone(tryBaud, reply);
+      return 1;
+    }
+    if(portBegin){
+      tryBaud = otherBaud(tryBaud);                       // alternate between both baud rates
+    }
+  } while(millis() - connectStart < ARDOXY_CONNECT_TIMEOUT);
+
+  if(!connected){
+    Serial.println(F("Couldn't establish connection"));
+  }
+  return 0;
+}
+
+// Remember baud rate and firmware version of a successful connection
+void Ardoxy::connectDone(long portBaud, int version)
+{
+  ver = version;
+  baud = portBaud;
+  connected = true;
+  if(connectHook){
+    connectHook(baud, ver);
+  }
+}
+
+// The other of the two baud rates of the FireSting
+long Ardoxy::otherBaud(long portBaud)
+{
+  return portBaud == 19200 ? 115200 : 19200;
+}
+
+// Register a function that is called with baud rate and firmware version after each successful begin(),
+// e.g. to store them in EEPROM and pass the baud rate to begin() after the next reset
+void Ardoxy::setConnectHook(void (*hook)(long baud, int ver))
+{
+  connectHook = hook;
+}
+
+// Baud rate of the last successful connection
+long Ardoxy::getBaud()
+{
+  return baud;
+}
+
+// Restore the connection after a failed command, cheapest step first:
+// 1. resync: drain stale bytes and ping the FireSting with #VERS at the current baud rate
+// 2. reconnect: reopen the port and run the full begin() handshake
+// If both fail, the FireSting counts as offline and further calls return 0 immediately until a pause has
+// elapsed, which doubles with every failure (setBackoff). Callers can thus skip the channels of an
+// unreachable FireSting and keep the others on schedule.
+// Returns:
+// 1 when the FireSting answers
+// 0 when it did not answer or the pause has not elapsed yet
+int Ardoxy::recover()
+{
+  startRecover();
+  waitForReply();
+  return status;
+}
+
+// Non-blocking recover(): call poll() until it returns true, then result() is 1 when the FireSting answers.
+// Each step is one #VERS command (a reconnect probes both baud rates for up to ARDOXY_CONNECT_TIMEOUT), so
+// an unreachable FireSting does not hold up the loop.
+void Ardoxy::startRecover()
+{
+  if(offline && (long)(millis() - retryAt) < 0){
+    startCommand("", 0, 0);     // completes at once with result 0
+    return;
+  }
+  startVer();
+  recoverStep = 1;
+}
+
+// Send #VERS without waiting for the reply (minimum: 3 values, the 3rd is the firmware version)
+void Ardoxy::startVer()
+{
+  setCommand(ARDOXY_CMD_VERS, 0);
+  startCommand(measCommand, 170, 3);
+}
+
+// Advance a recovery after a reply has completed
+// recoverStep 1: resync ping, 2: reconnect probe at the remembered baud rate, 3: probe at the other baud rate
+void Ardoxy::nextRecoverStep()
+{
+  byte step = recoverStep;
+  recoverStep = 0;
+  if(status == 1){
+    if(step == 1){
+      ver = fields[2];
+      ARDOXY_COUNT(resyncs);
     } else {
-      hwStream->begin(115200);
-      delay(3000);
-      while(hwStream->available()>0){
-        char t = hwStream->read();
-        delay(2);
-      }
-      hwStream->write("MSR 1\r");
-      delay(300);
-      if(hwStream->available()){
-        Serial.println("Hardware Serial Connection Established, Baudrate 115200");
-        while(hwStream->available()>0){
-          char t = hwStream->read();
-          delay(2);
-        }
-        ver = getVer();
-        Serial.print("Firmware Version: ");
-        Serial.println(ver);
-      } else {
-        Serial.println("Couldn't establish connection");
-      }
+      connectDone(step == 3 ? otherBaud(baud) : baud, fields[2]);
     }
+    offline = false;
+    backoff = backoffMin;
+    return;
   }
-  else
-  {
-    swStream->begin(19200);
-    delay(3000);
-    while(swStream->available()>0){
-      char t = swStream->read();
-      delay(2);
+  byte next = 2;                // probe the remembered baud rate
+  if(step == 1){
+    // Reconnect: reopen the port and probe as begin() does, one #VERS per step
+    end();
+    if(connected){
+      ARDOXY_COUNT(reconnects);
     }
-    swStream->write("MSR 1\r");
-    delay(300);
-    if(swStream->available()){
-      Serial.println("Software Serial Connection Established, Baudrate 19200");
-      while(swStream->available()>0){
-        char t = swStream->read();
-        delay(2);
-      }
-      ver = getVer();
-      Serial.print("Firmware Version: ");
-      Serial.println(ver);
-    } else {
-      swStream->begin(115200);
-      delay(3000);
-      while(swStream->available()>0){
-        char t = swStream->read();
-        delay(2);
-      }
-      swStream->write("MSR 1\r");
-      delay(300);
-      if(swStream->available()){
-        Serial.println("Software Serial Connection Established, Baudrate 115200");
-        while(swStream->available()>0){
-          char t = swStream->read();
-          delay(2);
-        }
-        ver = getVer();
-        Serial.print("Firmware Version: ");
-        Serial.println(ver);
-      } else {
-        Serial.println("Couldn't establish connection");
-      }
+#if ARDOXY_COMP_CACHE
+    compValid = false;          // the FireSting may have been restarted
+#endif
+    reconnectStart = millis();
+  } else if(millis() - reconnectStart >= ARDOXY_CONNECT_TIMEOUT){
+    status = 0;
+    offline = true;
+    retryAt = millis() + backoff;
+    backoff = backoff * 2 < backoffMax ? backoff * 2 : backoffMax;
+    return;
+  } else if(step == 2 && portBegin){
+    next = 3;                   // alternate between both baud rates
+  }
+  openPort(next == 3 ? otherBaud(baud) : baud);
+  startVer();
+  recoverStep = next;
+}
+
+// False after a failed recover() until the FireSting answers again
+bool Ardoxy::online()
+{
+  return !offline;
+}
+
+// Pause after the first failed recover() and upper limit of the doubling pauses [ms]
+void Ardoxy::setBackoff(unsigned long minMs, unsigned long maxMs)
+{
+  backoffMin = minMs;
+  backoffMax = maxMs;
+  backoff = minMs;
+}
+
+// (Re)open the serial port with the given baud rate
+void Ardoxy::openPort(long portBaud)
+{
+  if (portBegin)
+  {
+    portBegin(port, portBaud);
+    if (capture)
+    {
+      capture->opened(portBaud);
     }
   }
 }
@@ -100,480 +230,596 @@ void Ardoxy::begin()
 // End function
 void Ardoxy::end()
 {
-  if (hwStream)
+  if (portEnd)
   {
-    hwStream->end();
-  }
-  else
-  {
-    swStream->end();
+    portEnd(port);
   }
 }
 
 // Function to read the firmware version from the device
 int Ardoxy::getVer()
 {
-  int result;
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
-
-  // Empty Serial buffer
-  while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
-  }
+  int result = 0;
 
-  // Send command to FireSting
-  stream->write("#VERS\r");
-  stream->flush();
-  bool received = false;      // Switch to continue reading incoming data until end marker was received
-  delay(170);         // Let Firesting finish measurement before reading incoming serial data
+  startVer();
+  waitForReply();
 
-  if(!stream->available()){ // If there is no incoming data, there is a connection problem
-    result = 0;
-  }
-  else{
-    while (stream->available() > 0 && received == false && ndx <= numChars-1) {
-      delay(2);
-      rc = stream->read();
-      if (rc != endMarker && ndx < numChars-1) {
-        receivedChars[ndx] = rc;
-        ndx++;
-      }
-      else {
-        receivedChars[ndx] = '\0';  // terminate the string
-        ndx = 0;
-        received = true;
-        if(strncmp("#VERS", receivedChars, (strlen("#VERS")-1)) == 0){ // Compare command and received string (FS echoes the command)
-          // get the 4th value of the return string (values separated by spaces)
-          char *verChar = strtok(receivedChars, " ");
-          for(int i = 0; i < 3; i++){
-            verChar=strtok(NULL, " ");
-          }
-          result = atol(verChar);                         // parse the character to integers - the air saturation values are returned as [% air saturation x 1000], temperature as [°C x 1000]
-        }
-        else{
-          result = 9;             // return 9 if there is a mismatch
-        }
-      }
-    }
+  if(status == 1){
+    result = fields[2];     // the 4th value of the return string (values separated by spaces)
+  } else if(status == 9){
+    result = 9;             // return 9 if there is a mismatch
   }
   return result;
 }
 
-// Measure function: send measurement command to firesting via Serial communication
-// Returns:
-// 1 when echo matches command
-// 0 when there is no echo (connection problem)
-// 9 when there is a mismatch (usually due to timing or connection issues)
-int Ardoxy::measure(char command[], int serialDelay=300)
+// Write a command "op arg1 arg2 ...\r" into measCommand, op is the name of command type ARDOXY_CMD_*
+// If the command does not fit (e.g. a large channel or register number), measCommand is left empty and
+// startCommand() fails without sending anything
+void Ardoxy::setCommand(byte type, byte nArgs, int a, int b, int c, int d)
 {
-  int result;
+  int args[4] = {a, b, c, d};
+  char op[sizeof(commandNames[0])];
+  strcpy_P(op, commandNames[type]);
+  if(!ArdoxyParser::format(measCommand, ARDOXY_COMMAND_SIZE, op, args, nArgs)){
+    measCommand[0] = '\0';
+  }
+}
 
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
+// Start a command: empty the Serial buffer, send the command and arm the reply timeout.
+// The reply is collected by poll(): the echo is compared and the values following it are parsed into
+// dest (default: the internal fields array). The reply is valid if it has at least minValues values.
+// The command is copied into measCommand, which the parser compares the echo with, so the caller's buffer
+// may go out of scope right away. An empty command or one longer than ARDOXY_COMMAND_SIZE - 1 characters
+// is not sent: the command completes at once with result 0.
+void Ardoxy::startCommand(const char command[], unsigned int timeout, byte minValues, long dest[], byte destSize)
+{
+  val = 0;
+  status = 0;
+  replyEnd = 0;
+  readStep = 0;                 // a new command ends a pending measure-and-read or recovery
+  recoverStep = 0;
+  pending = false;
+  if(command != measCommand){
+    if(strlen(command) >= ARDOXY_COMMAND_SIZE){
+      return;
+    }
+    strcpy(measCommand, command);
+  }
+  if(!measCommand[0]){
+    return;
+  }
 
-  // Empty Serial buffer
+  // Empty Serial buffer (stale replies of earlier commands)
   while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
+    char c = stream->read();
+    ARDOXY_COUNT(bytesDrained);
+    if(capture){
+      capture->received(c);
+    }
   }
 
   // Send command to FireSting
-  stream->write(command);
-  stream->flush();
-  bool received = false;      // Switch to continue reading incoming data until end marker was received
-  delay(serialDelay);                 // Let Firesting finish measurement before reading incoming serial data
+  stream->write(measCommand);
+  if(capture){
+    capture->sent(measCommand, timeout, minValues);
+  }
+#if ARDOXY_STATS
+  cmdType = commandType(measCommand);
+  sentAtUs = micros();
+#endif
+  parser.begin(measCommand, dest ? dest : fields, dest ? destSize : ARDOXY_MAX_FIELDS);
+  minFields = minValues;
+  timeoutMs = timeout;
+  sentAt = millis();
+  pending = true;
+}
 
-  if(!stream->available()){ // If there is no incoming data, there is a connection problem
-    result = 0;
+// Move the received characters of the pending reply into the parser until the end marker arrives.
+// Bytes after the end marker stay in the port; the next command drains them.
+// Not reentrant: capture->flush() may write to an SD card whose driver calls yield() and thus serviceAll(),
+// which returns at once while any instance is inside service().
+void Ardoxy::service()
+{
+  if(!pending || replyEnd || inService){
+    return;
   }
-  else{
-    while (stream->available() > 0 && received == false && ndx <= numChars-1) {
-      delay(2);
-      rc = stream->read();
-      if (rc != endMarker && ndx < numChars-1) {
-        receivedChars[ndx] = rc;
-        ndx++;
-      }
-      else {
-        receivedChars[ndx] = '\0';  // terminate the string
-        ndx = 0;
-        received = true;
-        if(strncmp(command, receivedChars, (strlen(command)-1)) == 0){ // Compare command and received string (FS echoes the command)
-          result = 1;
-        }
-        else{
-          result = 9;             // return 9 if there is a mismatch
-        }
-      }
+  inService = true;
+  while(stream->available() > 0){
+    char rc = stream->read();
+    lastByteAt = millis();
+    if(capture){
+      capture->received(rc);
+    }
+    if (rc == ARDOXY_END_MARKER || parser.length() >= ARDOXY_MAX_REPLY) {
+      replyEnd = rc == ARDOXY_END_MARKER ? 1 : 2;
+      break;
     }
+    parser.feed(rc);            // compare the echo and parse values as the characters arrive
   }
-  return result;
+  if(capture){
+    capture->flush();           // one record per call: the bytes were waiting in the port when it was read
+  }
+  inService = false;
 }
 
-// Measure Sequence function: same as measure function but with pre-set measurement command
-int Ardoxy::measureSeq(int chan, int serialDelay=500)
+// Serve the pending replies of all instances (does nothing when called from within service())
+void Ardoxy::serviceAll()
 {
-  int result;
-  //char command;
-
-  // Paste Channel in measurement command
-  if(ver >= 400){
-    sprintf(measCommand, "MEA %d 3\r", chan);           // insert channel in measurement command
-  } else if (ver < 400) {
-    sprintf(measCommand, "SEQ %d\r", chan);           // insert channel in measurement command
+  if(inService){
+    return;
+  }
+  for(Ardoxy* a = instances; a; a = a->nextInstance){
+    a->service();
   }
+}
 
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
+// Collect the reply of the pending command without blocking
+// Returns:
+// true when the reply is complete (or timed out) and result() / value() are valid
+// false while the FireSting is still measuring or sending
+bool Ardoxy::poll()
+{
+  if(!pending){
+    return true;
+  }
 
-  // Empty Serial buffer
-  while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
+  service();
+  if(replyEnd){
+    completeReply(replyEnd == 1);
+    return !pending;            // a measure-and-read on older firmware or a recovery continues with its next command
   }
 
-  // Send command to FireSting
-  stream->write(measCommand);
-  stream->flush();
-  bool received = false;      // Switch to continue reading incoming data until end marker was received
-  delay(serialDelay);         // Let Firesting finish measurement before reading incoming serial data
+  // No end marker yet: give up if the first byte is overdue or the reply stalled midway
+  unsigned long now = millis();
+  if(parser.length() == 0 && now - sentAt > timeoutMs){
+    status = 0;                 // no reply -> connection problem
+    pending = false;
+    ARDOXY_COUNT(timeouts);
+  } else if(parser.length() > 0 && now - lastByteAt > ARDOXY_BYTE_TIMEOUT && now - sentAt > timeoutMs){
+    status = 9;                 // truncated reply
+    pending = false;
+    recordReply(false);
+  }
+  if(!pending && readStep){
+    nextReadStep();
+  } else if(!pending && recoverStep){
+    nextRecoverStep();
+  }
+  return !pending;
+}
 
-  if(!stream->available()){ // If there is no incoming data, there is a connection problem
-    result = 0;
+// End marker received (complete) or reply cut off: check echo and values of the reply
+void Ardoxy::completeReply(bool complete)
+{
+  parser.finish();
+  pending = false;
+  if(complete && parser.valid() && parser.count() >= minFields){   // FS echoes the command, followed by the requested values
+    status = 1;
+    val = parser.last();        // the air saturation values are returned as [% air saturation x 1000], temperature as [°C x 1000]
   }
   else{
-    while (stream->available() > 0 && received == false && ndx <= numChars-1) {
-      delay(2);
-      rc = stream->read();
-      if (rc != endMarker && ndx < numChars-1) {
-        receivedChars[ndx] = rc;
-        ndx++;
-      }
-      else {
-        receivedChars[ndx] = '\0';  // terminate the string
-        ndx = 0;
-        received = true;
-        if(strncmp(measCommand, receivedChars, (strlen(measCommand)-1)) == 0){ // Compare command and received string (FS echoes the command)
-          result = 1;
-        }
-        else{
-          result = 9;             // return 9 if there is a mismatch
-        }
-      }
+    status = 9;                 // return 9 if there is a mismatch or the reply was cut off
+  }
+  recordReply(complete);
+  if(readStep){
+    nextReadStep();
+  } else if(recoverStep){
+    nextRecoverStep();
+  }
+}
+
+// Update the statistics of the pending command type with a finished reply
+// complete: the end marker was received (otherwise the reply stalled or was cut off)
+void Ardoxy::recordReply(bool complete)
+{
+#if ARDOXY_STATS
+  if(!complete){
+    stats.truncated++;
+  } else if(status == 9){
+    stats.mismatches++;
+  }
+  ArdoxyCmdStats& c = stats.cmd[cmdType];
+  unsigned long rtt = micros() - sentAtUs;
+  if(c.count == 0){
+    c.rttMin = rtt;
+    c.rttMax = rtt;
+    c.rttAvg = rtt;
+  } else {
+    if(rtt < c.rttMin) c.rttMin = rtt;
+    if(rtt > c.rttMax) c.rttMax = rtt;
+    c.rttAvg = c.rttAvg - c.rttAvg / 8 + rtt / 8;
+  }
+  c.count++;
+#else
+  (void)complete;
+#endif
+}
+
+#if ARDOXY_STATS
+// Command type from the first characters of a command
+byte Ardoxy::commandType(const char command[])
+{
+  for(byte t = 0; t < ARDOXY_CMD_OTHER; t++){
+    if(!strncmp_P(command, commandNames[t], 3)){
+      return t;
     }
   }
-  return result;
+  return ARDOXY_CMD_OTHER;
 }
+#endif
 
-// Measure DO function: same as measure function but with pre-set measurement command
-int Ardoxy::measureDO(int chan, int serialDelay=100)
+// Record all bytes sent and read from now on (starts a new capture session), 0 stops recording
+void Ardoxy::setCapture(ArdoxyCapture* recorder)
 {
-  int result;
+  if(capture){
+    capture->flush();
+  }
+  capture = recorder;
+  if(capture){
+    capture->begin();
+  }
+}
 
-  // Paste Channel in measurement command
-  if(ver >= 400){
-    sprintf(measCommand, "MEA %d 1\r", chan);           // insert channel in measurement command
-  } else if (ver < 400) {
-    sprintf(measCommand, "MSR %d\r", chan);           // insert channel in measurement command
+#if ARDOXY_STATS
+// Communication statistics since the start or the last resetStats()
+const ArdoxyStats& Ardoxy::getStats()
+{
+  return stats;
+}
+
+void Ardoxy::resetStats()
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+// Print the statistics as a table, round trips in ms
+void Ardoxy::printStats(Print& out)
+{
+  static const char names[] PROGMEM = "VERSMSR TMP SEQ MEA REA RMR OTHR";
+  out.println(F("cmd  count  min[ms]  avg[ms]  max[ms]"));
+  for(byte t = 0; t < ARDOXY_CMD_TYPES; t++){
+    const ArdoxyCmdStats& c = stats.cmd[t];
+    if(c.count == 0){
+      continue;
+    }
+    for(byte i = 0; i < 4; i++){
+      out.write(pgm_read_byte(&names[4 * t + i]));
+    }
+    out.print(' ');
+    out.print(c.count);
+    out.print(' ');
+    out.print(c.rttMin / 1000.0);
+    out.print(' ');
+    out.print(c.rttAvg / 1000.0);
+    out.print(' ');
+    out.println(c.rttMax / 1000.0);
   }
+  out.print(F("timeouts: "));
+  out.print(stats.timeouts);
+  out.print(F(", mismatches: "));
+  out.print(stats.mismatches);
+  out.print(F(", truncated: "));
+  out.print(stats.truncated);
+  out.print(F(", resyncs: "));
+  out.print(stats.resyncs);
+  out.print(F(", reconnects: "));
+  out.print(stats.reconnects);
+  out.print(F(", bytes drained: "));
+  out.println(stats.bytesDrained);
+}
+#else
+void Ardoxy::resetStats()
+{
+}
 
+void Ardoxy::printStats(Print& out)
+{
+  out.println(F("statistics off (ARDOXY_STATS 0)"));
+}
+#endif
 
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
+// True while a command waits for its reply
+bool Ardoxy::busy()
+{
+  return pending;
+}
 
-  // Empty Serial buffer
-  while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
+// Status of the last completed command: 1 echo matches, 0 no reply, 9 mismatch
+int Ardoxy::result()
+{
+  return status;
+}
+
+// Value parsed from the last completed readout (0 if there was a communication problem)
+long Ardoxy::value()
+{
+  return val;
+}
+
+// Result of the last completed measure-and-read (ARDOXY_LOW_RAM: shared by all instances, so read it before
+// the next measure-and-read starts)
+const ArdoxyResult& Ardoxy::reading()
+{
+  return lastReading;
+}
+
+// Block until the pending command has completed
+void Ardoxy::waitForReply()
+{
+  while(!poll()){
+    yield();
   }
+}
 
-  // Send command to FireSting
-  stream->write(measCommand);
-  stream->flush();
-  bool received = false;      // Switch to continue reading incoming data until end marker was received
-  delay(serialDelay);         // Let Firesting finish measurement before reading incoming serial data
+// Non-blocking versions of the measure functions - see poll()
+void Ardoxy::startMeasure(const char command[], int timeout)
+{
+  startCommand(command, timeout, 0);
+}
 
-  if(!stream->available()){ // If there is no incoming data, there is a connection problem
-    result = 0;
+void Ardoxy::startMeasureSeq(int chan, int timeout)
+{
+  // Paste Channel in measurement command
+  if(ver >= 400){
+    setCommand(ARDOXY_CMD_MEA, 2, chan, 3);               // insert channel in measurement command
+  } else {
+    setCommand(ARDOXY_CMD_SEQ, 1, chan);                  // insert channel in measurement command
   }
-  else{
-    while (stream->available() > 0 && received == false && ndx <= numChars-1) {
-      delay(2);
-      rc = stream->read();
-      if (rc != endMarker && ndx < numChars-1) {
-        receivedChars[ndx] = rc;
-        ndx++;
-      }
-      else {
-        receivedChars[ndx] = '\0';  // terminate the string
-        ndx = 0;
-        received = true;
-        if(strncmp(measCommand, receivedChars, (strlen(measCommand)-1)) == 0){ // Compare command and received string (FS echoes the command)
-          result = 1;
-        }
-        else{
-          result = 9;             // return 9 if there is a mismatch
-        }
-      }
-    }
+  startCommand(measCommand, timeout, 0);
+}
+
+void Ardoxy::startMeasureDO(int chan, int timeout)
+{
+  // Paste Channel in measurement command
+  if(ver >= 400){
+    setCommand(ARDOXY_CMD_MEA, 2, chan, 1);               // insert channel in measurement command
+  } else {
+    setCommand(ARDOXY_CMD_MSR, 1, chan);                  // insert channel in measurement command
   }
-  return result;
+  startCommand(measCommand, timeout, 0);
 }
 
-// Measure DO function: same as measure function but with pre-set measurement command
-int Ardoxy::measureTemp(int serialDelay=300)
+void Ardoxy::startMeasureTemp(int timeout)
 {
-  int result;
   int chan = 1;
 
   // Paste Channel in measurement command
   if(ver >= 400){
-    sprintf(measCommand, "MEA %d 3\r", chan);           // insert channel in measurement command
-  } else if (ver < 400) {
-    sprintf(measCommand, "TMP %d\r", chan);           // insert channel in measurement command
+    setCommand(ARDOXY_CMD_MEA, 2, chan, 3);               // insert channel in measurement command
+  } else {
+    setCommand(ARDOXY_CMD_TMP, 1, chan);                  // insert channel in measurement command
   }
+  startCommand(measCommand, timeout, 0);
+}
 
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
+void Ardoxy::startReadout(const char command[], int timeout)
+{
+  startCommand(command, timeout, 1);
+}
 
-  // Empty Serial buffer
-  while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
+// Non-blocking measure-and-read: one MEA command with firmware >= 400, which returns the results in its reply.
+// Older firmware measures with SEQ and then reads the results register with one RMR command.
+// While the cached temperature and pressure are younger than setCompensationAge(), only DO is measured
+// (MEA n 1 / MSR n) and the cached values are reported.
+// poll() returns true when the whole sequence is done, reading() holds the result.
+void Ardoxy::startMeasureRead(int chan, int timeout)
+{
+#if ARDOXY_COMP_CACHE
+  readFull = !compMaxAge || !compValid || millis() - compAt >= compMaxAge;
+#else
+  readFull = true;
+#endif
+  readChan = chan;
+  lastReading.check = 0;
+  lastReading.status = 0;
+  lastReading.DO = 0;
+  lastReading.temp = 0;
+  lastReading.pressure = 0;
+  if(ver >= 400){
+    setCommand(ARDOXY_CMD_MEA, 2, chan, readFull ? 3 : 1);
+    startCommand(measCommand, timeout, ARDOXY_MAX_FIELDS);
+  } else {
+    setCommand(readFull ? ARDOXY_CMD_SEQ : ARDOXY_CMD_MSR, 1, chan);
+    startCommand(measCommand, timeout, 0);
   }
+  readStep = pending ? 1 : 0;
+}
 
-  // Send command to FireSting
-  stream->write(measCommand);
-  stream->flush();
-  bool received = false;      // Switch to continue reading incoming data until end marker was received
-  delay(serialDelay);         // Let Firesting finish measurement before reading incoming serial data
-
-  if(!stream->available()){ // If there is no incoming data, there is a connection problem
-    result = 0;
+// Advance a measure-and-read after a reply has completed
+void Ardoxy::nextReadStep()
+{
+  if(status != 1){              // communication problem: abort the sequence
+    lastReading.check = status;
+    readStep = 0;
+    return;
   }
-  else{
-    while (stream->available() > 0 && received == false && ndx <= numChars-1) {
-      delay(2);
-      rc = stream->read();
-      if (rc != endMarker && ndx < numChars-1) {
-        receivedChars[ndx] = rc;
-        ndx++;
-      }
-      else {
-        receivedChars[ndx] = '\0';  // terminate the string
-        ndx = 0;
-        received = true;
-        if(strncmp(measCommand, receivedChars, (strlen(measCommand)-1)) == 0){ // Compare command and received string (FS echoes the command)
-          result = 1;
-        }
-        else{
-          result = 9;             // return 9 if there is a mismatch
-        }
-      }
-    }
+  if(readStep == 1 && ver < 400){
+    // SEQ / MSR only echo: read registers 0 to 9 of the results register in one go
+    setCommand(ARDOXY_CMD_RMR, 4, readChan, 3, 0, ARDOXY_MAX_FIELDS);
+    startCommand(measCommand, 100, ARDOXY_MAX_FIELDS);
+    readStep = 2;
+    return;
   }
-  return result;
+  // The values follow the echo in the order of the results register
+  for(int i = 0; i < parser.count() && i < ARDOXY_MAX_FIELDS; i++){
+    storeRegister(i, fields[i]);
+  }
+#if ARDOXY_COMP_CACHE
+  if(readFull){
+    compTemp = lastReading.temp;
+    compPressure = lastReading.pressure;
+    compAt = millis();
+    compValid = true;
+  } else {
+    lastReading.temp = compTemp;
+    lastReading.pressure = compPressure;
+  }
+#endif
+  lastReading.check = 1;
+  readStep = 0;
 }
 
-// Readout values from Firesting memory
-// Returns:
-// numerical value (air saturation or temperature) - refer to Firesting Protocol
-// 0 if there is a communication mismatch
-long Ardoxy::readout(char command[])
-{                                       // receives serial data and stores it in array until endmarker is received
-  long valInt;                                                                          // receives parsed numerical value
+// Copy one value of the results register into the last reading
+void Ardoxy::storeRegister(int reg, long regValue)
+{
+  switch(reg){
+    case ARDOXY_REG_STATUS:
+      lastReading.status = regValue;
+      break;
+    case ARDOXY_REG_AIRSAT:
+      lastReading.DO = regValue;
+      break;
+    case ARDOXY_REG_TEMP:
+      lastReading.temp = regValue;
+      break;
+    case ARDOXY_REG_PRESSURE:
+      lastReading.pressure = regValue;
+      break;
+  }
+}
 
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
+// Non-blocking register readout: RMR command, the values are parsed directly into values[]
+// values must hold count entries and stay valid until poll() returns true
+void Ardoxy::startReadoutRegs(int chan, int first, int count, long values[], int timeout)
+{
+  setCommand(ARDOXY_CMD_RMR, 4, chan, 3, first, count);
+  startCommand(measCommand, timeout, count, values, count);
+}
 
-  // Empty Serial buffer
-  while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
-  }
-
-  stream->write(command);
-  stream->flush();
-  bool received = false;
-  delay(10);
-  while (stream->available() > 0 && received == false && ndx <= numChars-1) {          // only read serial data if the buffer was emptied before and it's new data
-    delay(2);
-    rc = stream->read();
-    if (rc != endMarker && ndx < numChars-1) {
-      receivedChars[ndx] = rc;                                                        // store the latest character in character array
-      ndx++;
-    }
-    else {
-      receivedChars[ndx] = '\0';                                                      // terminate the string if the end marker is received
-      ndx = 0;
-      if(strncmp(command, receivedChars, (strlen(command)-1)) == 0){
-        received = true;
-        char* separator = strrchr(receivedChars, ' ');    // the value is separated by a space -> strrchr finds the last occurrence of " " in receivedChars and points
-                                                          // to the following part of the string
-        valInt = atol(separator);                         // parse the character to integers - the air saturation values are returned as [% air saturation x 1000], temperature as [°C x 1000]
-      }
-      else{
-        valInt = 0;
-      }
-    }
-  }
-  return valInt;
+// Measure function: send measurement command to firesting via Serial communication
+// serialDelay is the maximum time to wait for the echo - the function returns as soon as the end marker arrives
+// Returns:
+// 1 when echo matches command
+// 0 when there is no echo (connection problem)
+// 9 when there is a mismatch (usually due to timing or connection issues)
+int Ardoxy::measure(char command[], int serialDelay)
+{
+  startMeasure(command, serialDelay);
+  waitForReply();
+  return status;
 }
 
-// readoutDO - Similar to readout function but with pre-set DO-readout command
-long Ardoxy::readoutDO(int chan)
-{                                       // receives serial data and stores it in array until endmarker is received
-  long valInt;                                                                          // receives parsed numerical value
+// Measure Sequence function: same as measure function but with pre-set measurement command
+int Ardoxy::measureSeq(int chan, int serialDelay)
+{
+  startMeasureSeq(chan, serialDelay);
+  waitForReply();
+  return status;
+}
 
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
+// Measure DO function: same as measure function but with pre-set measurement command
+int Ardoxy::measureDO(int chan, int serialDelay)
+{
+  startMeasureDO(chan, serialDelay);
+  waitForReply();
+  return status;
+}
 
-  // Empty Serial buffer
-  while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
-  }
+// Measure temperature function: same as measure function but with pre-set measurement command
+int Ardoxy::measureTemp(int serialDelay)
+{
+  startMeasureTemp(serialDelay);
+  waitForReply();
+  return status;
+}
 
-  // Paste Channel in measurement command
-  sprintf(measCommand, "RMR %d 3 4 1\r", chan);           // insert channel in measurement command
+// Measure and read DO, temperature, pressure and status of one channel
+// Returns:
+// 1 when the measurement and all values were received
+// 0 when there is no echo (connection problem)
+// 9 when there is a mismatch (usually due to timing or connection issues)
+int Ardoxy::measureRead(int chan, ArdoxyResult& res, int serialDelay)
+{
+  startMeasureRead(chan, serialDelay);
+  waitForReply();
+  res = lastReading;
+  return lastReading.check;
+}
 
-  stream->write(measCommand);
-  stream->flush();
-  bool received = false;
-  delay(10);
-  while (stream->available() > 0 && received == false && ndx <= numChars-1) {          // only read serial data if the buffer was emptied before and it's new data
-    delay(2);
-    rc = stream->read();
-    if (rc != endMarker && ndx < numChars-1) {
-      receivedChars[ndx] = rc;                                                        // store the latest character in character array
-      ndx++;
-    }
-    else {
-      receivedChars[ndx] = '\0';                                                      // terminate the string if the end marker is received
-      ndx = 0;
-      if(strncmp(measCommand, receivedChars, (strlen(measCommand)-1)) == 0){
-        received = true;
-        char* separator = strrchr(receivedChars, ' ');    // the value is separated by a space -> strrchr finds the last occurrence of " " in receivedChars and points
-                                                          // to the following part of the string
-        valInt = atol(separator);                         // parse the character to integers - the air saturation values are returned as [% air saturation x 1000], temperature as [°C x 1000]
-      }
-      else{
-        valInt = 0;
-      }
-    }
-  }
-  return valInt;
+// Measure temperature and air pressure with measureRead() only if the last measurement is older than maxAgeMs,
+// e.g. 60000 for a rack with one temperature sensor, where a full sequence on every channel wastes ~200 ms each
+// 0 (default): full sequence on every measureRead()
+#if ARDOXY_COMP_CACHE
+void Ardoxy::setCompensationAge(unsigned long maxAgeMs)
+{
+  compMaxAge = maxAgeMs;
 }
 
-// readoutDO - Similar to readout function but with pre-set DO-readout command
-long Ardoxy::readoutTemp()
-{                                       // receives serial data and stores it in array until endmarker is received
-  long valInt;                                                                          // receives parsed numerical value
+// Returns:
+// ms since temperature and pressure were last measured, 4294967295 if not measured since begin()
+unsigned long Ardoxy::compensationAge()
+{
+  return compValid ? millis() - compAt : 0xFFFFFFFFUL;
+}
+#else
+void Ardoxy::setCompensationAge(unsigned long)
+{
+}
 
-  // Set source Stream
-  stream = !hwStream? (Stream*)swStream : hwStream;
+unsigned long Ardoxy::compensationAge()
+{
+  return 0xFFFFFFFFUL;                                    // no cache: not measured for later DO-only readings
+}
+#endif
 
-  // Empty Serial buffer
-  while(stream->available() > 0){
-    char t = stream->read();
-    delay(2);
-  }
+// Read consecutive values of the results register, e.g. first = ARDOXY_REG_AIRSAT, count = 2 for DO and temperature
+// Returns:
+// 1 when all values were received
+// 0 when there is no echo (connection problem)
+// 9 when there is a mismatch or fewer values than requested
+int Ardoxy::readoutRegs(int chan, int first, int count, long values[])
+{
+  startReadoutRegs(chan, first, count, values);
+  waitForReply();
+  return status;
+}
 
+// Readout values from Firesting memory
+// Returns:
+// numerical value (air saturation or temperature) - refer to Firesting Protocol
+// 0 if there is a communication mismatch
+long Ardoxy::readout(char command[])
+{
+  startReadout(command);
+  waitForReply();
+  return val;
+}
+
+// readoutDO - Similar to readout function but with pre-set DO-readout command
+long Ardoxy::readoutDO(int chan)
+{
   // Paste Channel in measurement command
-  sprintf(measCommand, "RMR 1 3 5 1\r");           // insert channel in measurement command
+  setCommand(ARDOXY_CMD_RMR, 4, chan, 3, ARDOXY_REG_AIRSAT, 1);   // insert channel in measurement command
+  startReadout(measCommand);
+  waitForReply();
+  return val;
+}
 
-  stream->write(measCommand);
-  stream->flush();
-  bool received = false;
-  delay(10);
-  while (stream->available() > 0 && received == false && ndx <= numChars-1) {          // only read serial data if the buffer was emptied before and it's new data
-    delay(2);
-    rc = stream->read();
-    if (rc != endMarker && ndx < numChars-1) {
-      receivedChars[ndx] = rc;                                                        // store the latest character in character array
-      ndx++;
-    }
-    else {
-      receivedChars[ndx] = '\0';                                                      // terminate the string if the end marker is received
-      ndx = 0;
-      if(strncmp(measCommand, receivedChars, (strlen(measCommand)-1)) == 0){
-        received = true;
-        char* separator = strrchr(receivedChars, ' ');    // the value is separated by a space -> strrchr finds the last occurrence of " " in receivedChars and points
-                                                          // to the following part of the string
-        valInt = atol(separator);                         // parse the character to integers - the air saturation values are returned as [% air saturation x 1000], temperature as [°C x 1000]
-      }
-      else{
-        valInt = 0;
-      }
-    }
-  }
-  return valInt;
+// readoutTemp - Similar to readout function but with pre-set temperature-readout command
+long Ardoxy::readoutTemp()
+{
+  setCommand(ARDOXY_CMD_RMR, 4, 1, 3, ARDOXY_REG_TEMP, 1);
+  startReadout(measCommand);
+  waitForReply();
+  return val;
 }
 
-// Calculate duration in days between two given dates
+// Calculate duration in days between two given dates, counting both (if start and end date are the same, dur = 1)
 // Returns:
-// integer of number of days (if start and end date are the same, dur = 1)
+// integer of number of days (0 for the day before the start date, negative further back)
 int Ardoxy::calcDays(int startDay, int startMonth, int startYear, int endDay, int endMonth, int endYear) {
-  const int monthDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-  const int leapMonthDays[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-  int dayDuration = 0;
-  // option 1: it is the day of acclimation start
-  if (endDay == startDay && endMonth == startMonth && endYear == startYear){
-    dayDuration = 1;
-  } else if (endDay > startDay && endMonth == startMonth && endYear == startYear){
-    // option 2: it is past the start date and the same month
-    dayDuration = int(endDay - startDay + 1);
-  } else if (endMonth > startMonth && endYear == startYear){
-    // option 3: it is past the start month but the same year (-> the day can be different)
-    // sum up the days of the months between starting month and current month
-    if((endYear > 1970) && !(endYear%4) && ((endYear%100) || !(endYear%400))){
-      for (int j = startMonth; j < int(endMonth); j++){
-        dayDuration += leapMonthDays[j-1];
-      }
-    } else {
-      for (int j = startMonth; j < int(endMonth); j++){
-        dayDuration += monthDays[j-1];
-      }
-    }
-    // subtract the start date and add the current day
-    dayDuration -= startDay;
-    dayDuration += endDay;
-  } else if(endYear > startYear){
-    // option 4: it is past the starting year
-    if((startYear > 1970) && !(startYear%4) && ((startYear%100) || !(startYear%400))){
-      // option 4.1: the starting year was a leap year
-      for (int j = startMonth; j <= 12; j++){
-        dayDuration += leapMonthDays[j-1];
-      }
-      for(int j = 1; j <= int(endMonth); j++){        // crucial here: j starts at 1 and has to run until it is less or even the current month (for the case of january)
-        dayDuration += monthDays[j-1];
-      }
-      // subtract start day and the rest days of the current month (minus 1)
-      dayDuration -= (startDay + monthDays[endMonth-1] - endDay - 1);
-    } else if((endYear > 1970) && !(endYear%4) && ((endYear%100) || !(endYear%400))){
-      // option 4.2: the current year is a leap year
-      for (int j = startMonth; j <= 12; j++){
-        dayDuration += monthDays[j-1];
-      }
-      for(int j = 1; j <= int(endMonth); j++){
-        dayDuration += leapMonthDays[j-1];
-      }
-      // subtract start day and the rest days of the current month (minus 1)
-      dayDuration -= (startDay + leapMonthDays[endMonth-1] - endDay - 1);
-      Serial.println(dayDuration);
-    } else {
-      // option 4.3: no leap years
-      for (int j = startMonth; j <= 12; j++){
-        dayDuration += monthDays[j-1];
-      }
-      for(int j = 1; j <= int(endMonth); j++){
-        dayDuration += monthDays[j-1];
-      }
-      // subtract start day and the rest days of the current month (minus 1)
-      dayDuration -= (startDay + monthDays[endMonth-1] - endDay - 1);
-    }
-  }
-  return dayDuration;
+  return daysFromCivil(endYear, endMonth, endDay) - daysFromCivil(startYear, startMonth, startDay) + 1;
+}
+
+// Days since 1 January 1970 of a date in the proleptic Gregorian calendar, in constant time
+// (days-from-civil algorithm by Howard Hinnant: the year starts in March, so the leap day is its last day)
+// Returns:
+// number of days, negative before 1970
+long Ardoxy::daysFromCivil(int year, int month, int day) {
+  long y = year - (month <= 2);
+  long era = (y >= 0 ? y : y - 399) / 400;
+  long yoe = y - era * 400;                                                 // year of era [0, 399]
+  int doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;  // day of year, from 1 March [0, 365]
+  long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                         // day of era [0, 146096]
+  return era * 146097L + doe - 719468L;
 }
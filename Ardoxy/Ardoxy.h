@@ -7,16 +7,120 @@
 #define Ardoxy_h
 
 #include "Arduino.h"
-#include <SoftwareSerial.h>
+#include "ArdoxyParser.h"
+#include "ArdoxyCapture.h"
 
-#define numChars 60
+#define ARDOXY_BYTE_TIMEOUT 20                                              // ms allowed between two bytes of one reply before it counts as truncated
+#define ARDOXY_CONNECT_TIMEOUT 3000                                         // ms during which begin() keeps probing for the FireSting
+#define ARDOXY_MAX_REPLY 250                                                // replies without end marker are cut off after this many characters
+#define ARDOXY_MAX_FIELDS 10                                                // number of result values parsed from a MEA reply (R0 - R9)
+#define ARDOXY_BACKOFF_MIN 1000                                             // ms before the first retry after a failed recover()
+#define ARDOXY_BACKOFF_MAX 60000                                            // longest pause between two recover() attempts
+#define ARDOXY_END_MARKER '\r'                                              // character that marks the end of a FireSting reply
+#define ARDOXY_COMMAND_SIZE 16                                              // longest command incl. '\r' and terminator ("RMR 4 3 0 10\r")
+
+// Low-RAM build: all Ardoxy instances share one command buffer, reply parser, value array and the result of
+// the last measure-and-read, and the statistics and the compensation cache are left out unless switched on
+// below. Only one command may then be pending at a time: blocking calls never overlap, and the ArdoxyManager
+// measures its devices one after another instead of in parallel. The flags must be seen by the library
+// sources, so set them here or with compiler flags (-DARDOXY_LOW_RAM=1), not in the sketch.
+#ifndef ARDOXY_LOW_RAM
+#define ARDOXY_LOW_RAM 0
+#endif
+
+// Round-trip times and error counters (getStats(), printStats()), 152 bytes per instance on AVR
+#ifndef ARDOXY_STATS
+#if ARDOXY_LOW_RAM
+#define ARDOXY_STATS 0
+#else
+#define ARDOXY_STATS 1
+#endif
+#endif
+
+// Cached temperature and pressure for DO-only measurements (setCompensationAge()), 17 bytes per instance on AVR
+#ifndef ARDOXY_COMP_CACHE
+#if ARDOXY_LOW_RAM
+#define ARDOXY_COMP_CACHE 0
+#else
+#define ARDOXY_COMP_CACHE 1
+#endif
+#endif
+
+#if ARDOXY_LOW_RAM
+#define ARDOXY_SHARED static
+#else
+#define ARDOXY_SHARED
+#endif
+
+// Indices of the results register (register 3) - identical to the value order of a MEA reply
+#define ARDOXY_REG_STATUS 0                                                 // status bits
+#define ARDOXY_REG_DPHI 1                                                   // phase shift [m°]
+#define ARDOXY_REG_UMOLAR 2                                                 // oxygen [µmol/L x 1000]
+#define ARDOXY_REG_MBAR 3                                                   // oxygen partial pressure [mbar x 1000]
+#define ARDOXY_REG_AIRSAT 4                                                 // oxygen [% air saturation x 1000]
+#define ARDOXY_REG_TEMP 5                                                   // sample temperature [°C x 1000]
+#define ARDOXY_REG_TEMPCASE 6                                               // case temperature [°C x 1000]
+#define ARDOXY_REG_SIGNAL 7                                                 // signal intensity [mV x 1000]
+#define ARDOXY_REG_LIGHT 8                                                  // ambient light [mV x 1000]
+#define ARDOXY_REG_PRESSURE 9                                               // ambient air pressure [mbar x 1000]
+
+// Command types for the round-trip statistics
+#define ARDOXY_CMD_VERS 0                                                   // #VERS (begin, getVer)
+#define ARDOXY_CMD_MSR 1                                                    // DO measurement (firmware < 400)
+#define ARDOXY_CMD_TMP 2                                                    // temperature measurement (firmware < 400)
+#define ARDOXY_CMD_SEQ 3                                                    // measurement sequence (firmware < 400)
+#define ARDOXY_CMD_MEA 4                                                    // measurement (firmware >= 400)
+#define ARDOXY_CMD_REA 5                                                    // register readout
+#define ARDOXY_CMD_RMR 6                                                    // multi-register readout
+#define ARDOXY_CMD_OTHER 7                                                  // any other command
+#define ARDOXY_CMD_TYPES 8
+
+// Result of a combined measure-and-read (values as reported by the FireSting, x 1000)
+struct ArdoxyResult
+{
+  int check;                                                                // 1: success, 0: no connection, 9: mismatch
+  long status;                                                              // status bits reported by the FireSting
+  long DO;                                                                  // % air saturation x 1000
+  long temp;                                                                // °C x 1000
+  long pressure;                                                            // mbar x 1000
+};
+
+// Round trips of one command type: time from sending the command to the end of the reply
+struct ArdoxyCmdStats
+{
+  unsigned long count;                                                      // completed replies (timeouts are not timed)
+  unsigned long rttMin;                                                     // shortest round trip [µs]
+  unsigned long rttMax;                                                     // longest round trip [µs]
+  unsigned long rttAvg;                                                     // moving average (EWMA, weight 1/8) [µs]
+};
+
+// Communication statistics since the last resetStats()
+struct ArdoxyStats
+{
+  ArdoxyCmdStats cmd[ARDOXY_CMD_TYPES];                                     // indexed by ARDOXY_CMD_*
+  unsigned long timeouts;                                                   // no reply (result 0)
+  unsigned long mismatches;                                                 // complete reply with wrong echo or too few values (result 9)
+  unsigned long truncated;                                                  // reply stalled or exceeded ARDOXY_MAX_REPLY
+  unsigned long resyncs;                                                    // recover() calls answered by the first #VERS ping
+  unsigned long reconnects;                                                 // begin() calls after the first connection
+  unsigned long bytesDrained;                                               // stale bytes discarded before sending a command
+};
 
 class Ardoxy
 {
   public:
-    Ardoxy( HardwareSerial& device) {hwStream = &device;}
-    Ardoxy( SoftwareSerial& device) {swStream = &device;}
-    void begin();
+    // Any serial port with begin(baud) and end(), e.g. HardwareSerial, SoftwareSerial, AltSoftSerial, USB serial
+    template <class Port>
+    Ardoxy(Port& device) : stream(&device), port(&device), portBegin(&beginPort<Port>), portEnd(&endPort<Port>) {link();}
+    // A Stream that is opened by the caller: begin() only probes the FireSting, end() does nothing
+    Ardoxy(Stream& device) : stream(&device) {link();}
+    ~Ardoxy();
+    int begin(long knownBaud=0);
+    void setConnectHook(void (*hook)(long baud, int ver));
+    long getBaud();
+    int recover();
+    bool online();
+    void setBackoff(unsigned long minMs, unsigned long maxMs);
     void end();
     int getVer();
     int measure(char command[], int serialDelay=300);
@@ -27,17 +131,120 @@ class Ardoxy
     long readoutDO(int chan);
     long readoutTemp();
     static int calcDays(int startDay, int startMonth, int startYear, int endDay, int endMonth, int endYear);
+    static long daysFromCivil(int year, int month, int day);
+
+    // Non-blocking API: start a command, call poll() until it returns true, then fetch result() / value()
+    // Command strings are copied, the caller's buffer may be reused right away. Commands longer than
+    // ARDOXY_COMMAND_SIZE - 1 characters are not sent and complete at once with result 0.
+    void startMeasure(const char command[], int timeout=300);
+    void startMeasureSeq(int chan, int timeout=500);
+    void startMeasureDO(int chan, int timeout=100);
+    void startMeasureTemp(int timeout=300);
+    void startReadout(const char command[], int timeout=100);
+    void startMeasureRead(int chan, int timeout=500);
+    void startReadoutRegs(int chan, int first, int count, long values[], int timeout=100);
+    void startRecover();
+    bool poll();
+    bool busy();
+    int result();
+    long value();
+    const ArdoxyResult& reading();
+
+    // Receive the pending reply while the sketch is busy elsewhere: poll() does this too, but the serial receive
+    // buffer (64 bytes, ~5 ms of a reply at 115200 baud) overflows if poll() is not called in time.
+    // serviceAll() serves every instance, e.g. from yield(), which the AVR core calls during delay(). Calls made
+    // while an instance is inside service() (e.g. SdFat calling yield() during a capture write) return at once.
+    void service();
+    static void serviceAll();
+
+    // Combined measurement and readout: one MEA round trip (firmware >= 400), SEQ + register reads otherwise
+    int measureRead(int chan, ArdoxyResult& res, int serialDelay=500);
+
+    // Temperature and air pressure are measured once per device and compensate the DO of all its channels:
+    // measureRead() measures them at most every maxAgeMs and takes faster DO-only measurements in between
+    // (with ARDOXY_COMP_CACHE 0, every measureRead() measures them)
+    void setCompensationAge(unsigned long maxAgeMs);
+    unsigned long compensationAge();
+
+    // Read count consecutive values of the results register (e.g. DO, temperature, pressure) with one RMR command
+    int readoutRegs(int chan, int first, int count, long values[]);
+
+    // Record the serial traffic with µs timestamps (e.g. to SD) for extras/host/replay.cpp, 0 stops recording
+    void setCapture(ArdoxyCapture* recorder);
+
+    // Round-trip times and error counters, e.g. to tune intervals or to detect a degrading connection
+    // (with ARDOXY_STATS 0 there is no getStats(), and printStats() only says that the statistics are off)
+#if ARDOXY_STATS
+    const ArdoxyStats& getStats();
+#endif
+    void resetStats();
+    void printStats(Print& out);
 
   private:
-    HardwareSerial* hwStream;
-    SoftwareSerial* swStream;
-    Stream* stream;
+    void link();
+    void openPort(long portBaud);
+    void setCommand(byte type, byte nArgs, int a=0, int b=0, int c=0, int d=0);
+    void startCommand(const char command[], unsigned int timeout, byte minValues, long dest[]=0, byte destSize=0);
+    void completeReply(bool complete);
+    void storeRegister(int reg, long regValue);
+    void nextReadStep();
+    void waitForReply();
+    void recordReply(bool complete);
+    void startVer();
+    void nextRecoverStep();
+    void connectDone(long portBaud, int version);
+    static long otherBaud(long portBaud);
+#if ARDOXY_STATS
+    static byte commandType(const char command[]);
+#endif
+    template <class Port> static void beginPort(void* p, long portBaud) {static_cast<Port*>(p)->begin(portBaud);}
+    template <class Port> static void endPort(void* p) {static_cast<Port*>(p)->end();}
+    Stream* stream;                                                         // serial port the FireSting is connected to
+    void* port = 0;                                                         // the same port, for portBegin / portEnd
+    void (*portBegin)(void* p, long portBaud) = 0;                          // opens the port with its own begin() (0: opened by the caller)
+    void (*portEnd)(void* p) = 0;                                           // closes the port with its own end()
     int ver;
-    int ndx = 0;                                                            // index for storing in the array
-    char receivedChars[numChars];                                           // Array to hold incoming data
-    char endMarker = '\r';                                                  // declare the character that marks the end of a serial transmission
-    char rc;                                                                // temporary variable to hold the last received character
-    char measCommand[13];                                                   // Buffer for measurement command
+    long baud = 19200;                                                      // baud rate that is probed first by begin()
+    void (*connectHook)(long baud, int ver) = 0;                            // called after a successful begin()
+    ARDOXY_SHARED char measCommand[ARDOXY_COMMAND_SIZE];                    // Buffer for measurement command
+    bool pending = false;                                                   // true while a command waits for its reply
+    byte replyEnd = 0;                                                      // 1: end marker received, 2: reply cut off at ARDOXY_MAX_REPLY
+    ARDOXY_SHARED ArdoxyParser parser;                                      // parses the reply of the pending command as it arrives
+    byte minFields;                                                         // values the reply of the pending command must contain
+    int status = 0;                                                         // 1: echo matches, 0: no reply, 9: mismatch or truncated reply
+    long val = 0;                                                           // value parsed from the last readout reply
+    unsigned long sentAt;                                                   // ms timestamp when the pending command was sent
+    unsigned long lastByteAt;                                               // ms timestamp of the last received byte
+    unsigned int timeoutMs;                                                 // max. time to wait for the first byte of the reply
+    bool connected = false;                                                 // true after the first successful begin()
+#if ARDOXY_STATS
+    unsigned long sentAtUs;                                                 // µs timestamp when the pending command was sent
+    byte cmdType;                                                           // ARDOXY_CMD_* of the pending command
+    ArdoxyStats stats = {};
+#endif
+    bool offline = false;                                                   // true after a failed recover() until one succeeds
+    unsigned long retryAt;                                                  // ms timestamp before which recover() does not retry
+    unsigned long backoff = ARDOXY_BACKOFF_MIN;                             // pause after the next failed recover()
+    unsigned long backoffMin = ARDOXY_BACKOFF_MIN;
+    unsigned long backoffMax = ARDOXY_BACKOFF_MAX;
+    byte recoverStep = 0;                                                   // 0: idle, 1: resync ping, 2/3: reconnect probe (remembered / other baud rate)
+    unsigned long reconnectStart;                                           // ms timestamp when the reconnect of the pending recovery started
+    ARDOXY_SHARED long fields[ARDOXY_MAX_FIELDS];                           // values following the echo (unless the caller supplies an array)
+    int readChan;                                                           // channel of the pending measure-and-read
+    byte readStep = 0;                                                      // 0: idle, 1: measuring, >1: reading registers (older firmware)
+    ARDOXY_SHARED ArdoxyResult lastReading;                                 // result of the last measure-and-read
+    bool readFull;                                                          // the pending measure-and-read includes temperature and pressure
+#if ARDOXY_COMP_CACHE
+    unsigned long compMaxAge = 0;                                           // ms until temperature and pressure are measured again (0: every time)
+    unsigned long compAt;                                                   // ms timestamp of the last measurement of temperature and pressure
+    bool compValid = false;                                                 // compTemp / compPressure were measured on this connection
+    long compTemp;                                                          // cached temperature [°C x 1000]
+    long compPressure;                                                      // cached air pressure [mbar x 1000]
+#endif
+    Ardoxy* nextInstance;                                                   // list of all instances for serviceAll()
+    ArdoxyCapture* capture = 0;                                             // records the serial traffic (0: off)
+    static Ardoxy* instances;
+    static bool inService;                                                  // an instance is inside service() (guards against yield())
 };
 
 #endif
@@ -0,0 +1,184 @@
+/*
+  ArdoxyAlarm.cpp - Non-blocking low DO alarm for several channels.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyAlarm.h>
+
+// Set up the channels, all without alarm
+// Returns:
+// 1 - success
+// 0 - more than ARDOXY_ALARM_CHANNELS channels
+int ArdoxyAlarm::begin(byte channels)
+{
+  if (channels > ARDOXY_ALARM_CHANNELS) {
+    return 0;
+  }
+  nChannels = channels;
+  for (byte k = 0; k < nChannels; k++) {
+    thresholds[k] = 0;
+    hysteresis[k] = 0;
+    states[k] = ARDOXY_ALARM_OK;
+    latches[k] = false;
+    acked[k] = false;
+    lastDO[k] = 0;
+  }
+  return 1;
+}
+
+// threshold and hysteresis in % air saturation x 1000: the alarm is raised below threshold
+// and recovers at or above threshold + hysteresis
+void ArdoxyAlarm::setThreshold(byte k, long threshold, long hyst)
+{
+  if (k < nChannels) {
+    thresholds[k] = threshold;
+    hysteresis[k] = hyst;
+  }
+}
+
+// Time in ms that DO has to stay at or above threshold + hysteresis before the alarm clears
+void ArdoxyAlarm::setRecovery(unsigned long ms)
+{
+  recovery = ms;
+}
+
+// true: latched() reports an alarm until acknowledge(), also after it cleared
+void ArdoxyAlarm::setLatching(bool latch)
+{
+  latching = latch;
+}
+
+// Function called with the channel and DO (x 1000) when an alarm is raised
+void ArdoxyAlarm::onRaise(void (*callback)(byte k, long DO))
+{
+  raiseCallback = callback;
+}
+
+// Function called with the channel and its last DO (x 1000) when an alarm clears
+void ArdoxyAlarm::onClear(void (*callback)(byte k, long DO))
+{
+  clearCallback = callback;
+}
+
+// Check a measurement of channel k (x 1000); invalid measurements change nothing
+// Returns the state of the channel (ARDOXY_ALARM_OK, _LOW or _RECOVERING)
+byte ArdoxyAlarm::check(byte k, long DO, bool valid)
+{
+  if (k >= nChannels) {
+    return ARDOXY_ALARM_OK;
+  }
+  if (!valid) {
+    return states[k];
+  }
+  lastDO[k] = DO;
+  unsigned long now = millis();
+  switch (states[k]) {
+    case ARDOXY_ALARM_OK:
+      if (DO < thresholds[k]) {
+        states[k] = ARDOXY_ALARM_LOW;
+        latches[k] = true;
+        acked[k] = false;
+        raisedAt[k] = now;
+        if (raiseCallback) {
+          raiseCallback(k, DO);
+        }
+      }
+      break;
+    case ARDOXY_ALARM_LOW:
+      if (DO >= thresholds[k] + hysteresis[k]) {
+        states[k] = ARDOXY_ALARM_RECOVERING;
+        recoverStart[k] = now;
+      }
+      break;
+    case ARDOXY_ALARM_RECOVERING:
+      if (DO < thresholds[k] + hysteresis[k]) {
+        states[k] = ARDOXY_ALARM_LOW;                                       // still the same alarm, no new callback
+      }
+      break;
+  }
+  update();
+  return states[k];
+}
+
+// Clear the alarms whose recovery time has passed; call from loop(), the timer runs without new measurements
+// Returns the number of active alarms
+int ArdoxyAlarm::update()
+{
+  unsigned long now = millis();
+  int count = 0;
+  for (byte k = 0; k < nChannels; k++) {
+    if (states[k] == ARDOXY_ALARM_RECOVERING && now - recoverStart[k] >= recovery) {
+      clear(k);
+    }
+    if (states[k] != ARDOXY_ALARM_OK) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void ArdoxyAlarm::clear(byte k)
+{
+  states[k] = ARDOXY_ALARM_OK;
+  if (!latching || acked[k]) {
+    latches[k] = false;
+  }
+  if (clearCallback) {
+    clearCallback(k, lastDO[k]);
+  }
+}
+
+byte ArdoxyAlarm::state(byte k)
+{
+  return k < nChannels ? states[k] : ARDOXY_ALARM_OK;
+}
+
+// True while the alarm of channel k is raised (low or recovering)
+bool ArdoxyAlarm::active(byte k)
+{
+  return state(k) != ARDOXY_ALARM_OK;
+}
+
+// True while the alarm is active or, with latching, raised and not yet acknowledged
+bool ArdoxyAlarm::latched(byte k)
+{
+  return k < nChannels && latches[k];
+}
+
+// Number of channels with an active alarm
+int ArdoxyAlarm::activeCount()
+{
+  int count = 0;
+  for (byte k = 0; k < nChannels; k++) {
+    if (states[k] != ARDOXY_ALARM_OK) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Acknowledge the alarm of channel k: the latch is released now or, if the alarm is still active, when it clears
+void ArdoxyAlarm::acknowledge(byte k)
+{
+  if (k >= nChannels) {
+    return;
+  }
+  if (states[k] == ARDOXY_ALARM_OK) {
+    latches[k] = false;
+  } else {
+    acked[k] = true;
+  }
+}
+
+void ArdoxyAlarm::acknowledgeAll()
+{
+  for (byte k = 0; k < nChannels; k++) {
+    acknowledge(k);
+  }
+}
+
+// ms since the alarm of channel k was raised (0 if it is not active)
+unsigned long ArdoxyAlarm::since(byte k)
+{
+  return active(k) ? millis() - raisedAt[k] : 0;
+}
@@ -0,0 +1,59 @@
+/*
+  ArdoxyAlarm.h - Non-blocking low DO alarm for several channels.
+  A channel raises its alarm when a valid measurement falls below its threshold. The alarm stays active until
+  DO has been at or above threshold + hysteresis for the recovery time; a measurement below that restarts the
+  timer. Callbacks run when an alarm is raised and when it clears, e.g. to stop N2 and open an air valve.
+  With latching, a cleared alarm stays reported by latched() until it is acknowledged. Nothing blocks:
+  measuring, logging and control of the other channels go on while an alarm is active.
+*/
+
+#ifndef ArdoxyAlarm_h
+#define ArdoxyAlarm_h
+
+#include "Arduino.h"
+
+#ifndef ARDOXY_ALARM_CHANNELS
+#define ARDOXY_ALARM_CHANNELS 16
+#endif
+
+#define ARDOXY_ALARM_OK 0                                                   // DO above the threshold
+#define ARDOXY_ALARM_LOW 1                                                  // DO below threshold + hysteresis
+#define ARDOXY_ALARM_RECOVERING 2                                           // DO back above threshold + hysteresis, recovery timer running
+
+class ArdoxyAlarm
+{
+  public:
+    int begin(byte channels);
+    void setThreshold(byte k, long threshold, long hysteresis);
+    void setRecovery(unsigned long ms);
+    void setLatching(bool latch);
+    void onRaise(void (*callback)(byte k, long DO));
+    void onClear(void (*callback)(byte k, long DO));
+    byte check(byte k, long DO, bool valid=true);
+    int update();
+    byte state(byte k);
+    bool active(byte k);
+    bool latched(byte k);
+    int activeCount();
+    void acknowledge(byte k);
+    void acknowledgeAll();
+    unsigned long since(byte k);
+
+  private:
+    void clear(byte k);
+    byte nChannels = 0;
+    long thresholds[ARDOXY_ALARM_CHANNELS];                                 // % air saturation x 1000
+    long hysteresis[ARDOXY_ALARM_CHANNELS];
+    byte states[ARDOXY_ALARM_CHANNELS];
+    bool latches[ARDOXY_ALARM_CHANNELS];                                    // raised and not yet acknowledged
+    bool acked[ARDOXY_ALARM_CHANNELS];                                      // acknowledged while still active
+    unsigned long raisedAt[ARDOXY_ALARM_CHANNELS];                          // ms timestamp of the last raise
+    unsigned long recoverStart[ARDOXY_ALARM_CHANNELS];                      // ms timestamp when DO was back above the hysteresis band
+    long lastDO[ARDOXY_ALARM_CHANNELS];                                     // last valid measurement
+    unsigned long recovery = 1200000UL;                                     // ms above the band before the alarm clears
+    bool latching = true;
+    void (*raiseCallback)(byte k, long DO) = 0;
+    void (*clearCallback)(byte k, long DO) = 0;
+};
+
+#endif
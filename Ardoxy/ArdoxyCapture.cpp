@@ -0,0 +1,90 @@
+/*
+  ArdoxyCapture.cpp - Records the serial traffic between Ardoxy and a FireSting with µs timestamps.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyCapture.h>
+
+// Start a session: the timestamps of the following records count from here
+// Called by Ardoxy::setCapture(); a file that is appended to after each reset holds one session per start
+void ArdoxyCapture::begin()
+{
+  nRx = 0;
+  last = micros();
+  byte start[8] = {ARDOXY_CAPTURE_START, 'A', 'X', ARDOXY_CAPTURE_VERSION};
+  for (byte i = 0; i < 4; i++) {
+    start[4 + i] = (last >> (8 * i)) & 0xFF;
+  }
+  written += out->write(start, sizeof(start));
+}
+
+// The port was opened with the given baud rate
+void ArdoxyCapture::opened(long baud)
+{
+  flush();
+  header(ARDOXY_CAPTURE_OPEN, micros());
+  varint(baud);
+}
+
+// A command was sent (up to 127 characters), with the timeout and number of values its reply is checked against
+void ArdoxyCapture::sent(const char data[], unsigned int timeoutMs, byte minValues)
+{
+  flush();
+  size_t n = strlen(data);
+  if (n > 0x7F) {
+    n = 0x7F;
+  }
+  if (n == 0) {
+    return;
+  }
+  header(ARDOXY_CAPTURE_TX | n, micros());
+  varint(timeoutMs);
+  written += out->write(minValues);
+  written += out->write((const uint8_t*)data, n);
+}
+
+// A byte was read from the port: collected until flush() or ARDOXY_CAPTURE_CHUNK bytes
+void ArdoxyCapture::received(char c)
+{
+  if (nRx == 0) {
+    rxAt = micros();
+  }
+  rx[nRx++] = c;
+  if (nRx >= ARDOXY_CAPTURE_CHUNK) {
+    flush();
+  }
+}
+
+// Write the collected received bytes as one record, stamped with the time the first of them was read
+void ArdoxyCapture::flush()
+{
+  if (nRx == 0) {
+    return;
+  }
+  header(nRx, rxAt);
+  written += out->write((const uint8_t*)rx, nRx);
+  nRx = 0;
+}
+
+// Bytes written since the start, e.g. to close a capture file before the card fills up
+unsigned long ArdoxyCapture::bytes()
+{
+  return written;
+}
+
+void ArdoxyCapture::header(byte tag, unsigned long at)
+{
+  written += out->write(tag);
+  varint(at - last);
+  last = at;
+}
+
+// Unsigned LEB128: 7 bits per byte, least significant first, bit 7 set if more bytes follow
+void ArdoxyCapture::varint(unsigned long v)
+{
+  while (v >= 0x80) {
+    written += out->write((uint8_t)((v & 0x7F) | 0x80));
+    v >>= 7;
+  }
+  written += out->write((uint8_t)v);
+}
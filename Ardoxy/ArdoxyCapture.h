@@ -0,0 +1,51 @@
+/*
+  ArdoxyCapture.h - Records the serial traffic between Ardoxy and a FireSting with µs timestamps.
+  Attached with Ardoxy::setCapture(), it writes every command sent and every byte read from the port
+  (including stale bytes that are drained) to any Print, e.g. a file on an SD card or a second serial port.
+  extras/host/replay.cpp feeds a capture back through the library with the recorded reply timing, so a
+  misbehaving session from the field can be reproduced and used as a regression or latency benchmark.
+
+  Records: tag (1), time since the previous record in µs (unsigned LEB128 varint), payload
+    ARDOXY_CAPTURE_START   'A' 'X' version (1), micros() of the start (4, little endian) - no time field
+    ARDOXY_CAPTURE_OPEN    baud rate (varint): the port was (re)opened by begin()
+    0x01 - 0x7F            tag bytes received from the FireSting (read in one go)
+    0x81 - 0xFF            reply timeout in ms (varint), values the reply must contain (1), then the
+                           tag & 0x7F bytes of the command sent to the FireSting
+*/
+
+#ifndef ArdoxyCapture_h
+#define ArdoxyCapture_h
+
+#include "Arduino.h"
+
+#ifndef ARDOXY_CAPTURE_CHUNK
+#define ARDOXY_CAPTURE_CHUNK 16                                             // received bytes collected in one record (max. 127)
+#endif
+#define ARDOXY_CAPTURE_VERSION 1
+#define ARDOXY_CAPTURE_OPEN 0x00                                            // record tags
+#define ARDOXY_CAPTURE_START 0x80
+#define ARDOXY_CAPTURE_TX 0x80                                              // flag of sent bytes
+
+class ArdoxyCapture
+{
+  public:
+    ArdoxyCapture(Print& port) : out(&port) {}
+    void begin();
+    void opened(long baud);
+    void sent(const char data[], unsigned int timeoutMs, byte minValues);
+    void received(char c);
+    void flush();
+    unsigned long bytes();
+
+  private:
+    void header(byte tag, unsigned long at);
+    void varint(unsigned long v);
+    Print* out;
+    unsigned long last = 0;                                                 // µs timestamp of the last record
+    unsigned long rxAt;                                                     // µs timestamp of the first byte in rx
+    char rx[ARDOXY_CAPTURE_CHUNK];                                          // received bytes of the next record
+    byte nRx = 0;
+    unsigned long written = 0;                                              // bytes written to out
+};
+
+#endif
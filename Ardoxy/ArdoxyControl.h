@@ -0,0 +1,156 @@
+/*
+  ArdoxyControl.h - Integer PID control of N tanks, each bubbled through one solenoid valve.
+  The number of channels is a template parameter, so all channel state (one ArdoxyControlChannel
+  per tank) is allocated at compile time. Inputs and setpoints are % air saturation x 1000 as
+  reported by Ardoxy; the output of each channel is the valve opening time in ms for the next interval.
+  The algorithm follows the PID library by Brett Beauregard (integral clamped to the output limits,
+  derivative on the measurement), in fixed-point arithmetic.
+*/
+
+#ifndef ArdoxyControl_h
+#define ArdoxyControl_h
+
+#include "Arduino.h"
+#include "ArdoxyValves.h"
+
+#define ARDOXY_DIRECT 0                                                     // output rises when DO is below the setpoint (e.g. air)
+#define ARDOXY_REVERSE 1                                                    // output rises when DO is above the setpoint (e.g. N2)
+
+// State of one control channel
+struct ArdoxyControlChannel
+{
+  long setpoint;                                                            // % air saturation x 1000
+  long kp;                                                                  // ms opening time per % air saturation of error
+  long ki;                                                                  // ms per (% air saturation x s)
+  long kd;                                                                  // ms per (% air saturation / s)
+  long input;                                                               // last measurement, % air saturation x 1000
+  long lastInput;                                                           // measurement of the previous compute()
+  long integral;                                                            // integral term [µs]
+  long output;                                                              // valve opening time [ms]
+  bool valid;                                                               // input is a current measurement
+  bool primed;                                                              // lastInput holds a measurement
+};
+
+template <byte N>
+class ArdoxyControl
+{
+  public:
+    // Register one valve per channel (pins in channel order, LOW opens the valve by default)
+    void begin(ArdoxyValves& valves, const byte pins[N], byte openLevel=LOW)
+    {
+      for (byte k = 0; k < N; k++) {
+        int v = valves.addValve(pins[k], openLevel);
+        if (k == 0) {
+          firstValve = v;
+        }
+      }
+    }
+
+    void setSetpoint(byte k, long setpoint) {chan[k].setpoint = setpoint;}
+
+    // Gains in ms of valve opening time: per % air saturation (kp), per % x s (ki), per % / s (kd)
+    void setTunings(byte k, long kp, long ki, long kd)
+    {
+      chan[k].kp = kp;
+      chan[k].ki = ki;
+      chan[k].kd = kd;
+    }
+
+    void setSampleTime(unsigned long ms) {sampleTime = ms ? ms : 1;}
+
+    // Range of the opening time in ms; the integral term is limited to the same range
+    void setOutputLimits(long minMs, long maxMs)
+    {
+      outMin = minMs;
+      outMax = maxMs;
+    }
+
+    void setDirection(byte dir) {direction = dir;}
+
+    // Measurement of channel k; an invalid input closes the valve and leaves the channel state untouched
+    void setInput(byte k, long DO, bool valid=true)
+    {
+      chan[k].input = DO;
+      chan[k].valid = valid;
+    }
+
+    // Compute the opening times of all channels (once per sample time)
+    void compute()
+    {
+      for (byte k = 0; k < N; k++) {
+        computeChannel(chan[k], sampleTime, sampleTime);
+      }
+    }
+
+    // Compute channel k only, e.g. as soon as its measurement is in (once per sample time)
+    void compute(byte k) {computeChannel(chan[k], sampleTime, sampleTime);}
+
+    // Compute channel k with a varying interval (e.g. ArdoxyInterval): stepMs since its last compute (integral
+    // and derivative), intervalMs until its next one. The opening time is scaled from the sample time to
+    // intervalMs, so the share of time the valve is open does not depend on the interval.
+    void compute(byte k, unsigned long stepMs, unsigned long intervalMs)
+    {
+      computeChannel(chan[k], stepMs ? stepMs : sampleTime, intervalMs ? intervalMs : sampleTime);
+    }
+
+    // Open the valves for their computed times; opening times below minMs are skipped
+    void apply(ArdoxyValves& valves, unsigned long minMs=0)
+    {
+      for (byte k = 0; k < N; k++) {
+        apply(valves, k, minMs);
+      }
+    }
+
+    void apply(ArdoxyValves& valves, byte k, unsigned long minMs)
+    {
+      long ms = chan[k].output;
+      valves.open(firstValve + k, ms >= (long)minMs ? ms : 0);
+    }
+
+    long output(byte k) {return chan[k].output;}
+    const ArdoxyControlChannel& channel(byte k) {return chan[k];}
+    static constexpr byte channels() {return N;}
+
+  private:
+    void computeChannel(ArdoxyControlChannel& c, unsigned long step, unsigned long interval)
+    {
+      if (!c.valid) {
+        c.output = 0;
+        return;
+      }
+      if (!c.primed) {
+        c.lastInput = c.input;
+        c.primed = true;
+      }
+      long error = c.input - c.setpoint;                                    // x 1000
+      long dInput = c.input - c.lastInput;
+      if (direction == ARDOXY_DIRECT) {
+        error = -error;
+        dInput = -dInput;
+      }
+      c.lastInput = c.input;
+
+      // integral [µs] += ki [ms/(% s)] * error [% x 1000] * step [ms] / 1000
+      long long integral = c.integral + (long long)c.ki * error * (long long)step / 1000;
+      long long limMin = (long long)outMin * 1000;
+      long long limMax = (long long)outMax * 1000;
+      integral = integral < limMin ? limMin : (integral > limMax ? limMax : integral);
+      c.integral = integral;
+
+      // output [ms] = (kp * error / 1000 + integral / 1000 + kd * dInput / step) * interval / sampleTime
+      long long out = (long long)c.kp * error / 1000 + integral / 1000 + (long long)c.kd * dInput / (long long)step;
+      if (interval != sampleTime) {
+        out = out * (long long)interval / (long long)sampleTime;
+      }
+      c.output = out < outMin ? outMin : (out > outMax ? outMax : out);
+    }
+
+    ArdoxyControlChannel chan[N] = {};
+    unsigned long sampleTime = 1000;                                        // ms between two compute() calls
+    long outMin = 0;
+    long outMax = 15000;
+    byte direction = ARDOXY_REVERSE;
+    int firstValve = 0;                                                     // valve index of channel 0
+};
+
+#endif
@@ -0,0 +1,233 @@
+/*
+  ArdoxyFilter.cpp - Fixed-memory filter for oversampled FireSting readings (x 1000 fixed point).
+*/
+
+#include <Arduino.h>
+#include <ArdoxyFilter.h>
+
+// Start a new series of readings (settings are kept)
+void ArdoxyFilter::reset()
+{
+  head = 0;
+  n = 0;
+  nRejected = 0;
+  origin = 0;
+  sum = 0;
+  sumSq = 0;
+}
+
+// Add a reading, e.g. the value of readoutDO() with the result of the measurement
+// Returns:
+// true if the value was accepted
+// false if it was rejected (check is not 1, or a spike - the first three values are checked together)
+bool ArdoxyFilter::add(long value, int check)
+{
+  if (check != 1) {
+    nRejected++;
+    return false;
+  }
+  if (spikeLimit > 0 && n >= 3) {
+    long deviation = value - median();
+    if (deviation > spikeLimit || deviation < -spikeLimit) {
+      nRejected++;
+      return false;
+    }
+  }
+  window[head] = value;
+  head = (head + 1) % ARDOXY_FILTER_WINDOW;
+  if (n < 255) {
+    n++;
+    update(value);                                                          // the statistics stop at 255 values
+  }
+  if (spikeLimit > 0 && n == 3) {
+    return dropEarlySpikes();
+  }
+  return true;
+}
+
+// Add an accepted value to the sums (deviations from the first value keep them small)
+void ArdoxyFilter::update(long value)
+{
+  if (n == 1) {
+    origin = value;
+  }
+  long d = value - origin;
+  unsigned long ad = d < 0 ? -d : d;
+  sum += d;
+  if (ad > 0xFFFF || ad * ad > 0xFFFFFFFF - sumSq) {
+    sumSq = 0xFFFFFFFF;
+  } else {
+    sumSq += ad * ad;
+  }
+}
+
+// Sum of the squared deviations from the mean: sumSq - sum^2 / n, with sum = q n + r so that no product
+// overflows: sum^2 / n = q (sum + r) + r^2 / n (0xFFFFFFFF if sumSq is saturated)
+unsigned long ArdoxyFilter::squares()
+{
+  if (n == 0 || sumSq == 0xFFFFFFFF) {
+    return sumSq;
+  }
+  unsigned long s = sum < 0 ? -sum : sum;                                   // q and r have the sign of sum
+  unsigned long q = s / n;
+  unsigned long r = s % n;
+  return sumSq - q * (s + r) - r * r / n;
+}
+
+// Integer square root, rounded to the nearest integer
+static unsigned long isqrt(unsigned long x)
+{
+  unsigned long root = 0;
+  unsigned long bit = 1UL << 30;
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return x > root ? root + 1 : root;                                        // x is the remainder
+}
+
+// The first values can't be checked for spikes (no median yet): once there are three, remove
+// those that deviate from the median and recompute the statistics from the remaining ones
+// Returns false if the last added value was removed
+bool ArdoxyFilter::dropEarlySpikes()
+{
+  long med = median();
+  long kept[3];
+  byte nKept = 0;
+  bool lastKept = false;
+  for (byte i = 0; i < 3; i++) {
+    long deviation = window[i] - med;
+    if (deviation <= spikeLimit && deviation >= -spikeLimit) {
+      kept[nKept++] = window[i];
+      lastKept = i == 2;
+    }
+  }
+  if (nKept == 3) {
+    return true;
+  }
+  nRejected += 3 - nKept;
+  head = 0;
+  n = 0;
+  sum = 0;
+  sumSq = 0;
+  for (byte i = 0; i < nKept; i++) {
+    window[head++] = kept[i];
+    n++;
+    update(kept[i]);
+  }
+  return lastKept;
+}
+
+// Add the DO value of a measure-and-read
+bool ArdoxyFilter::add(const ArdoxyResult& res)
+{
+  return add(res.DO, res.check);
+}
+
+// Reject values that deviate from the median of the window by more than limit (x 1000, 0: off)
+void ArdoxyFilter::setSpikeLimit(long limit)
+{
+  spikeLimit = limit;
+}
+
+// converged() becomes true once at least minSamples values were accepted and the standard error
+// of their mean is at most maxError (x 1000, e.g. 50 for 0.05 % air saturation)
+void ArdoxyFilter::setTarget(long maxError, byte minSamples)
+{
+  targetError = maxError;
+  targetMin = minSamples < 2 ? 2 : minSamples;
+}
+
+bool ArdoxyFilter::converged()
+{
+  if (targetError <= 0 || n < targetMin || sumSq == 0xFFFFFFFF) {
+    return false;
+  }
+  // standard error = sqrt(squares / (n - 1) / n), compared squared
+  unsigned long target = targetError < 0xFFFF ? targetError : 0xFFFF;
+  return squares() / ((unsigned long)(n - 1) * n) <= target * target;
+}
+
+// Number of accepted values since reset()
+byte ArdoxyFilter::count()
+{
+  return n;
+}
+
+// Number of rejected values since reset()
+byte ArdoxyFilter::rejected()
+{
+  return nRejected;
+}
+
+// Mean of all accepted values (0 if there are none)
+long ArdoxyFilter::mean()
+{
+  if (n == 0) {
+    return 0;
+  }
+  return origin + (sum + (sum < 0 ? -(n / 2) : n / 2)) / n;
+}
+
+// Sample standard deviation of all accepted values
+long ArdoxyFilter::stddev()
+{
+  if (n < 2) {
+    return 0;
+  }
+  return sumSq == 0xFFFFFFFF ? 0xFFFF : isqrt(squares() / (n - 1));
+}
+
+// Median of the values in the window (0 if there are none)
+long ArdoxyFilter::median()
+{
+  long sorted[ARDOXY_FILTER_WINDOW];
+  byte size = sortWindow(sorted);
+  if (size == 0) {
+    return 0;
+  }
+  if (size % 2) {
+    return sorted[size / 2];
+  }
+  return (sorted[size / 2 - 1] + sorted[size / 2]) / 2;
+}
+
+// Mean of the values in the window without the trim lowest and trim highest values
+long ArdoxyFilter::trimmedMean(byte trim)
+{
+  long sorted[ARDOXY_FILTER_WINDOW];
+  byte size = sortWindow(sorted);
+  if (size <= 2 * trim) {
+    return median();
+  }
+  long sum = 0;
+  for (byte i = trim; i < size - trim; i++) {
+    sum += sorted[i] - sorted[trim];                                        // offsets keep the sum small
+  }
+  return sorted[trim] + sum / (size - 2 * trim);
+}
+
+// Copy the window into sorted[] in ascending order (insertion sort, at most ARDOXY_FILTER_WINDOW values)
+// Returns the number of values
+byte ArdoxyFilter::sortWindow(long sorted[])
+{
+  byte size = n < ARDOXY_FILTER_WINDOW ? n : ARDOXY_FILTER_WINDOW;
+  for (byte i = 0; i < size; i++) {
+    long v = window[i];
+    byte j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return size;
+}
@@ -0,0 +1,56 @@
+/*
+  ArdoxyFilter.h - Fixed-memory filter for oversampled FireSting readings (x 1000 fixed point).
+  Failed readings (check 0 or 9) are rejected instead of being averaged in as 0, and so are spikes
+  that deviate from the median by more than a set limit. Accepted readings update running sums for mean and
+  variance and a window of the last ARDOXY_FILTER_WINDOW values for median and trimmed mean.
+  With setTarget(), converged() tells when the standard error of the mean is small enough to stop sampling.
+  All arithmetic is on long values (x 1000), so the filter does not pull the floating point routines into a sketch.
+  Mean, stddev() and converged() cover the first 255 accepted values after reset(); later values only enter the
+  window. The variance saturates when the sum of the squared deviations from the first value exceeds 4.29e9 (x 1000
+  squared, e.g. one value 65.5 units away from the first); stddev() then reports 65535 and converged() stays false.
+*/
+
+#ifndef ArdoxyFilter_h
+#define ArdoxyFilter_h
+
+#include "Arduino.h"
+#include "Ardoxy.h"
+
+#ifndef ARDOXY_FILTER_WINDOW
+#define ARDOXY_FILTER_WINDOW 16                                             // values kept for median and trimmed mean
+#endif
+
+class ArdoxyFilter
+{
+  public:
+    void reset();
+    bool add(long value, int check=1);
+    bool add(const ArdoxyResult& res);
+    void setSpikeLimit(long limit);
+    void setTarget(long maxError, byte minSamples=3);
+    bool converged();
+    byte count();
+    byte rejected();
+    long mean();
+    long stddev();
+    long median();
+    long trimmedMean(byte trim=1);
+
+  private:
+    void update(long value);
+    unsigned long squares();
+    bool dropEarlySpikes();
+    byte sortWindow(long sorted[]);
+    long window[ARDOXY_FILTER_WINDOW];                                      // ring buffer of accepted values
+    byte head = 0;                                                          // next position in the ring buffer
+    byte n = 0;                                                             // accepted values since reset()
+    byte nRejected = 0;                                                     // rejected values since reset()
+    long origin = 0;                                                        // first accepted value, the sums hold deviations from it
+    long sum = 0;                                                           // sum of the deviations
+    unsigned long sumSq = 0;                                                // sum of the squared deviations (saturates at 0xFFFFFFFF)
+    long spikeLimit = 0;                                                    // max. deviation from the median (0: off)
+    long targetError = 0;                                                   // standard error at which converged() is true (0: never)
+    byte targetMin = 3;                                                     // samples needed before converged() can be true
+};
+
+#endif
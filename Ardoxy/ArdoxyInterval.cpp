@@ -0,0 +1,91 @@
+/*
+  ArdoxyInterval.cpp - Adaptive measurement interval of one channel.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyInterval.h>
+
+// Shortest and longest interval in ms; the interval starts at the shortest (equal limits: fixed interval)
+// activeMs: longest interval while the channel is actively controlled (0: maxMs), e.g. the interval
+// the PID was tuned for - samples taken once per long valve pulse miss the ripple it causes
+void ArdoxyInterval::setLimits(unsigned long minMs, unsigned long maxMs, unsigned long activeMs)
+{
+  minInterval = minMs;
+  maxInterval = maxMs > minMs ? maxMs : minMs;
+  activeInterval = activeMs ? (activeMs < minInterval ? minInterval : activeMs) : maxInterval;
+  current = minInterval;
+}
+
+// rateLimit: change of DO in % air saturation x 1000 per minute, errorLimit: distance from the setpoint
+// in % air saturation x 1000. Reaching either one halves the interval.
+void ArdoxyInterval::setThresholds(long rate, long error)
+{
+  rateLimit = rate;
+  errorLimit = error;
+}
+
+// Valid measurement DO (x 1000) taken at now (millis()) of a channel controlled to setpoint (x 1000)
+// active: the valve of the channel was operated since the last measurement
+void ArdoxyInterval::update(long DO, long setpoint, unsigned long now, bool active)
+{
+  lastStep = primed ? now - lastValid : 0;
+  if (lastStep > 0) {
+    lastRate = (long long)(DO - lastDO) * 60000LL / (long long)lastStep;
+  }
+  long absRate = lastRate < 0 ? -lastRate : lastRate;
+  // distance from the setpoint now and, at the current rate, by the end of the interval
+  long error = DO - setpoint;
+  long projected = error + (long long)lastRate * (long long)current / 60000LL;
+  long absError = error < 0 ? -error : error;
+  if (projected < 0) projected = -projected;
+  if (projected > absError) absError = projected;
+  if (absRate >= rateLimit || absError >= errorLimit) {
+    current /= 2;                                                           // fast: follow the change
+  } else if (absRate < rateLimit / 2 && absError < errorLimit / 2) {
+    current += current / 4;                                                 // slow: relax toward the maximum
+  }
+  unsigned long longest = active ? activeInterval : maxInterval;
+  current = current < minInterval ? minInterval : (current > longest ? longest : current);
+  lastDO = DO;
+  lastValid = now;
+  primed = true;
+  last = now;
+  started = true;
+}
+
+// The measurement at now failed: try again after the current interval, keep the rate
+void ArdoxyInterval::skip(unsigned long now)
+{
+  last = now;
+  started = true;
+}
+
+// True when the channel is to be measured (always before the first measurement)
+bool ArdoxyInterval::due(unsigned long now)
+{
+  return !started || now - last >= current;
+}
+
+// ms by which the measurement is overdue at now (0 if it is not due or was never taken)
+unsigned long ArdoxyInterval::late(unsigned long now)
+{
+  return started && due(now) ? now - last - current : 0;
+}
+
+// Current interval in ms
+unsigned long ArdoxyInterval::interval()
+{
+  return current;
+}
+
+// ms between the last two valid measurements (0 after the first one), e.g. the time step of the PID
+unsigned long ArdoxyInterval::step()
+{
+  return lastStep;
+}
+
+// Change of DO between the last two valid measurements, % air saturation x 1000 per minute
+long ArdoxyInterval::rate()
+{
+  return lastRate;
+}
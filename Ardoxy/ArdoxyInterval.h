@@ -0,0 +1,44 @@
+/*
+  ArdoxyInterval.h - Adaptive measurement interval of one channel.
+  After each measurement, the interval is halved if DO changes fast (|dDO/dt| at or above the rate limit)
+  or is far from the setpoint (|error| now or, at the current rate, by the next measurement at or above the
+  error limit), e.g. after a setpoint step. It grows by a quarter while both are below half of their limits,
+  up to the maximum (a lower one while the valve is operated), and is kept in between.
+  A stable tank is thus measured rarely (less serial traffic and optode light exposure), a changing one often.
+*/
+
+#ifndef ArdoxyInterval_h
+#define ArdoxyInterval_h
+
+#include "Arduino.h"
+
+class ArdoxyInterval
+{
+  public:
+    void setLimits(unsigned long minMs, unsigned long maxMs, unsigned long activeMs=0);
+    void setThresholds(long rateLimit, long errorLimit);
+    void update(long DO, long setpoint, unsigned long now, bool active=false);
+    void skip(unsigned long now);
+    bool due(unsigned long now);
+    unsigned long late(unsigned long now);
+    unsigned long interval();
+    unsigned long step();
+    long rate();
+
+  private:
+    unsigned long minInterval = 10000;                                      // ms
+    unsigned long maxInterval = 120000;                                     // ms
+    unsigned long activeInterval = 120000;                                  // ms, longest while the valve is operated
+    unsigned long current = 10000;                                          // ms until the next measurement
+    long rateLimit = 1000;                                                  // % air saturation x 1000 per minute
+    long errorLimit = 5000;                                                 // % air saturation x 1000
+    unsigned long last = 0;                                                 // ms timestamp of the last measurement (or failed one)
+    unsigned long lastValid = 0;                                            // ms timestamp of lastDO
+    unsigned long lastStep = 0;                                             // ms between the last two valid measurements
+    long lastDO = 0;
+    long lastRate = 0;
+    bool primed = false;                                                    // lastDO and lastValid hold a measurement
+    bool started = false;                                                   // a measurement was taken or skipped
+};
+
+#endif
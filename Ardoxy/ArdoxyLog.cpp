@@ -0,0 +1,144 @@
+/*
+  ArdoxyLog.cpp - Compact binary log of DO measurements, written in 512-byte blocks.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyLog.h>
+#include <ArdoxyParser.h>
+
+// Start a new log: prepares the header block, which is written with the first record
+// fileId marks every block of the file (e.g. the RTC epoch at the start), so that stale data
+// in a pre-allocated file is not mistaken for records
+// Returns:
+// 1 - success
+// 0 - too many channels for one record
+int ArdoxyLog::begin(unsigned long fileId, unsigned int interval, byte channels, const char tempID[])
+{
+  if (channels > ARDOXY_LOG_CHANNELS) {
+    return 0;
+  }
+  id = fileId;
+  nChannels = channels;
+  recSize = 8 + 2 * channels;
+  perBlock = (ARDOXY_LOG_BLOCK - ARDOXY_LOG_BLOCK_HEADER) / recSize;
+  block = 0;
+  nRecords = 0;
+  inBlock = 0;
+  memset(buffer, 0, ARDOXY_LOG_BLOCK);
+  memcpy(buffer, "ARDOXYL1", 8);
+  put32(8, id);
+  put16(12, interval);
+  buffer[14] = channels;
+  buffer[15] = recSize;
+  strncpy((char*)&buffer[16], tempID, ARDOXY_LOG_ID_LEN);
+  headerPending = true;
+  return 1;
+}
+
+// Describe channel k in the header (call after begin(), before the first record)
+// threshold: air saturation threshold x 1000
+void ArdoxyLog::setChannel(byte k, const char tankID[], byte chan, long threshold)
+{
+  if (!headerPending || k >= nChannels) {
+    return;
+  }
+  int pos = 22 + k * 9;
+  strncpy((char*)&buffer[pos], tankID, ARDOXY_LOG_ID_LEN);
+  buffer[pos + 6] = chan;
+  put16(pos + 7, ArdoxyParser::centi(threshold));
+}
+
+// Append one record; the block is written as soon as it is full
+// temp and DO[] as reported by Ardoxy (x 1000), stored with two decimals
+// failed: bit k set if the measurement of channel k failed
+// Returns:
+// 1 - success
+// 0 - a block could not be written (a full block is retried with the next record)
+int ArdoxyLog::add(unsigned long epoch, long temp, const long DO[], unsigned int failed)
+{
+  if (headerPending || inBlock >= perBlock) {
+    if (!sync()) {
+      return 0;
+    }
+  }
+  int pos = ARDOXY_LOG_BLOCK_HEADER + inBlock * recSize;
+  put32(pos, epoch);
+  put16(pos + 4, ArdoxyParser::centi(temp));
+  put16(pos + 6, failed);
+  for (byte k = 0; k < nChannels; k++) {
+    put16(pos + 8 + 2 * k, ArdoxyParser::centi(DO[k]));
+  }
+  inBlock++;
+  put16(6, inBlock);
+  nRecords++;
+  if (inBlock >= perBlock) {
+    return sync();
+  }
+  return 1;
+}
+
+// Write the buffered records now, e.g. before the file is closed. A partial block is written
+// in place and completed later, so calling this after every record costs one sector write each.
+// Returns:
+// 1 - success (or nothing to write)
+// 0 - the block could not be written
+int ArdoxyLog::sync()
+{
+  if (headerPending) {
+    if (!writeBuffer()) {
+      return 0;
+    }
+    headerPending = false;
+    block = 1;
+    startBlock();
+    return 1;
+  }
+  if (inBlock == 0) {
+    return 1;
+  }
+  if (!writeBuffer()) {
+    return 0;
+  }
+  if (inBlock >= perBlock) {
+    block++;
+    startBlock();
+  }
+  return 1;
+}
+
+// Number of records added since begin()
+unsigned long ArdoxyLog::records()
+{
+  return nRecords;
+}
+
+byte ArdoxyLog::recordSize()
+{
+  return recSize;
+}
+
+int ArdoxyLog::writeBuffer()
+{
+  return blockWriter(block, buffer) ? 1 : 0;
+}
+
+void ArdoxyLog::startBlock()
+{
+  memset(buffer, 0, ARDOXY_LOG_BLOCK);
+  put32(0, id);
+  put16(4, block);
+  put16(6, 0);
+  inBlock = 0;
+}
+
+void ArdoxyLog::put16(int pos, unsigned int v)
+{
+  buffer[pos] = v & 0xFF;
+  buffer[pos + 1] = (v >> 8) & 0xFF;
+}
+
+void ArdoxyLog::put32(int pos, unsigned long v)
+{
+  put16(pos, v & 0xFFFF);
+  put16(pos + 2, v >> 16);
+}
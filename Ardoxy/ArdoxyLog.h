@@ -0,0 +1,58 @@
+/*
+  ArdoxyLog.h - Compact binary log of DO measurements, written in 512-byte blocks.
+  One record holds the RTC time, the temperature and the DO of every channel as 16-bit values (x 100)
+  plus one status bit per channel. Records are collected in a RAM block and handed to a callback as a
+  full sector, e.g. to write it into a pre-allocated, contiguous SD file. Block 0 holds the file header.
+  extras/host/log_decode.cpp converts a log back to the CSV layout of the measure_control_4chan example.
+
+  File layout (little endian):
+  - header block: "ARDOXYL1", uint32 file id (start epoch), uint16 interval [s], uint8 channels,
+    uint8 record size, char tempID[6], then per channel: char tankID[6], uint8 channel, int16 threshold (x 100)
+  - data blocks: uint32 file id, uint16 block number, uint16 record count, then the records:
+    uint32 epoch, int16 temperature (x 100), uint16 status bits (bit k set: channel k failed), int16 DO (x 100) per channel
+  The block number in the file is 16 bits and wraps after 65536 blocks (32 MB); the decoder compares it modulo 65536.
+
+  Records stay in RAM until their block is full: on a power failure or reset, up to one partial block is lost
+  (31 records with 4 channels, i.e. 31 sampling intervals) unless sync() was called after the last record.
+  The object holds the 512-byte block buffer; on a 2 KB Uno, leave it out of sketches that do not log in binary.
+*/
+
+#ifndef ArdoxyLog_h
+#define ArdoxyLog_h
+
+#include "Arduino.h"
+
+#define ARDOXY_LOG_BLOCK 512                                                // bytes per block (one SD sector)
+#define ARDOXY_LOG_CHANNELS 16                                              // channels per record (one status bit each)
+#define ARDOXY_LOG_BLOCK_HEADER 8                                           // file id, block number and record count
+#define ARDOXY_LOG_ID_LEN 6                                                 // length of tank and temperature sensor IDs
+
+class ArdoxyLog
+{
+  public:
+    ArdoxyLog(bool (*writeBlock)(unsigned long block, const byte data[])) {blockWriter = writeBlock;}
+    int begin(unsigned long fileId, unsigned int interval, byte channels, const char tempID[]);
+    void setChannel(byte k, const char tankID[], byte chan, long threshold);
+    int add(unsigned long epoch, long temp, const long DO[], unsigned int failed=0);
+    int sync();
+    unsigned long records();
+    byte recordSize();
+
+  private:
+    int writeBuffer();
+    void startBlock();
+    void put16(int pos, unsigned int v);
+    void put32(int pos, unsigned long v);
+    bool (*blockWriter)(unsigned long block, const byte data[]);
+    byte buffer[ARDOXY_LOG_BLOCK];
+    unsigned long id = 0;                                                   // file id, marks the blocks of this file
+    unsigned long block = 0;                                                // number of the block in the buffer
+    unsigned long nRecords = 0;
+    byte nChannels = 0;
+    byte recSize = 0;
+    byte perBlock = 0;                                                      // records per data block
+    byte inBlock = 0;                                                       // records in the buffer
+    bool headerPending = false;                                             // buffer still holds the header block
+};
+
+#endif
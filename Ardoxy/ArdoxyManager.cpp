@@ -0,0 +1,224 @@
+/*
+  ArdoxyManager.cpp - Acquisition manager for several FireSting devices.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyManager.h>
+
+// Register a FireSting (begin() must have been called)
+// Returns the device index for addChannel(), -1 if ARDOXY_MAX_DEVICES is reached
+int ArdoxyManager::addDevice(Ardoxy& device)
+{
+  if (nDevices >= ARDOXY_MAX_DEVICES) {
+    return -1;
+  }
+  devices[nDevices] = &device;
+  current[nDevices] = -1;
+  failed[nDevices] = false;
+  recovering[nDevices] = false;
+  nDevices++;
+  return nDevices - 1;
+}
+
+// Add a channel of a device to the cycle
+// Returns the index of the channel in the snapshot, -1 if the device is unknown or ARDOXY_MAX_CHANNELS is reached
+int ArdoxyManager::addChannel(int device, int chan)
+{
+  if (device < 0 || device >= nDevices || nChannels >= ARDOXY_MAX_CHANNELS) {
+    return -1;
+  }
+  chanDevice[nChannels] = device;
+  chanNumber[nChannels] = chan;
+  enabled[nChannels] = true;
+  nChannels++;
+  return nChannels - 1;
+}
+
+// Timeout for one measure-and-read in ms (see Ardoxy::startMeasureRead)
+void ArdoxyManager::setTimeout(int timeout)
+{
+  measTimeout = timeout;
+}
+
+// Function called with the snapshot index and result of each channel as soon as it is measured. The device
+// measures its next channel meanwhile, so the hook overlaps with the measurement. Keep it shorter than
+// the time it takes to fill the serial receive buffer of the other devices (64 bytes: ~30 ms at 19200 baud).
+void ArdoxyManager::setResultHook(void (*hook)(int slot, const ArdoxyResult& res))
+{
+  resultHook = hook;
+}
+
+// Skip a channel in the following cycles (e.g. once its oversampling has converged) or measure it again
+void ArdoxyManager::enableChannel(int slot, bool enable)
+{
+  if (slot >= 0 && slot < nChannels) {
+    enabled[slot] = enable;
+  }
+}
+
+// Start a cycle: every device starts measuring its first channel
+// Devices that did not answer in the last cycle are recovered first; the recovery runs in poll() like a
+// measurement, so the other devices measure meanwhile
+void ArdoxyManager::startCycle()
+{
+  ArdoxySnapshot& back = snaps[!front];
+  back.started = millis();
+  cycleStartUs = micros();
+  back.count = nChannels;
+  for (byte i = 0; i < nChannels; i++) {
+    back.results[i].check = 0;
+  }
+  for (byte d = 0; d < nDevices; d++) {
+    current[d] = -1;
+    recovering[d] = false;
+  }
+#if ARDOXY_LOW_RAM
+  if (nDevices) {
+    startDevice(0);                                                         // the devices start one after another, see startNext()
+  }
+#else
+  for (byte d = 0; d < nDevices; d++) {
+    startDevice(d);
+  }
+#endif
+  active = true;
+}
+
+// Start the cycle of a device: recover it if it failed in the last cycle, otherwise measure its first channel
+void ArdoxyManager::startDevice(byte device)
+{
+  if (failed[device]) {
+    recovering[device] = true;
+    devices[device]->startRecover();
+  } else {
+    startNext(device);
+  }
+}
+
+// Start the next channel of a device after slot current[device], or mark the device as done
+// A failed device skips its remaining channels (check stays 0)
+void ArdoxyManager::startNext(byte device)
+{
+  for (int i = current[device] + 1; !failed[device] && i < nChannels; i++) {
+    if (chanDevice[i] == device && enabled[i]) {
+      current[device] = i;
+      measStart[device] = micros();
+      devices[device]->startMeasureRead(chanNumber[i], measTimeout);
+      return;
+    }
+  }
+  current[device] = nChannels;
+#if ARDOXY_LOW_RAM
+  if (device + 1 < nDevices) {
+    startDevice(device + 1);                                                // shared receive buffers: the next device starts when this one is done
+  }
+#endif
+}
+
+// Collect results without blocking
+// Returns true once when the cycle is complete and snapshot() holds the new results
+bool ArdoxyManager::poll()
+{
+  if (!active) {
+    return false;
+  }
+  bool done = true;
+  for (byte d = 0; d < nDevices; d++) {
+    if (recovering[d]) {
+      done = false;
+      if (devices[d]->poll()) {
+        recovering[d] = false;
+        failed[d] = devices[d]->result() != 1;
+        startNext(d);                                                       // skips the channels if the device is still offline
+      }
+      continue;
+    }
+    if (current[d] < 0) {
+      done = false;                                                         // not started yet (ARDOXY_LOW_RAM)
+      continue;
+    }
+    if (current[d] >= nChannels) {
+      continue;
+    }
+    if (devices[d]->poll()) {
+      timeStage(ARDOXY_STAGE_MEASURE, measStart[d]);
+      int slot = current[d];
+      snaps[!front].results[slot] = devices[d]->reading();
+      failed[d] = devices[d]->reading().check == 0;
+      startNext(d);                                                         // measure the next channel while this one is processed
+      if (resultHook) {
+        unsigned long hookStart = micros();
+        resultHook(slot, snaps[!front].results[slot]);
+        timeStage(ARDOXY_STAGE_PROCESS, hookStart);
+      }
+    }
+    if (current[d] < nChannels) {
+      done = false;
+    }
+  }
+  if (!done) {
+    return false;
+  }
+  ArdoxySnapshot& back = snaps[!front];
+  back.completed = millis();
+  timeStage(ARDOXY_STAGE_CYCLE, cycleStartUs);
+  back.cycle = ++cycles;
+  front = !front;                                                           // publish
+  active = false;
+  return true;
+}
+
+// True while a cycle is running
+bool ArdoxyManager::busy()
+{
+  return active;
+}
+
+// Last complete snapshot (cycle 0 if none has completed yet)
+const ArdoxySnapshot& ArdoxyManager::snapshot()
+{
+  return snaps[front];
+}
+
+// Record the duration of a stage that started at startedUs (micros()) and ends now
+void ArdoxyManager::timeStage(byte stage, unsigned long startedUs)
+{
+  if (stage >= ARDOXY_STAGES) {
+    return;
+  }
+  stages[stage].add(micros() - startedUs);
+}
+
+const ArdoxyStageStats& ArdoxyManager::stageStats(byte stage)
+{
+  return stages[stage < ARDOXY_STAGES ? stage : 0];
+}
+
+void ArdoxyManager::resetTiming()
+{
+  memset(stages, 0, sizeof(stages));
+}
+
+// Print the stage durations in ms
+void ArdoxyManager::printTiming(Print& out)
+{
+  static const char names[] PROGMEM = "measure process cycle   finish  ";
+  out.println(F("stage   count  last[ms]  min[ms]  avg[ms]  max[ms]"));
+  for (byte st = 0; st < ARDOXY_STAGES; st++) {
+    if (stages[st].count == 0) {
+      continue;
+    }
+    for (byte i = 0; i < 8; i++) {
+      out.write(pgm_read_byte(&names[8 * st + i]));
+    }
+    out.print(stages[st].count);
+    out.print(' ');
+    out.print(stages[st].last / 1000.0);
+    out.print(' ');
+    out.print(stages[st].min / 1000.0);
+    out.print(' ');
+    out.print(stages[st].avg / 1000.0);
+    out.print(' ');
+    out.println(stages[st].max / 1000.0);
+  }
+}
@@ -0,0 +1,106 @@
+/*
+  ArdoxyManager.h - Acquisition manager for several FireSting devices.
+  Each device measures its channels one after another (a FireSting answers one command at a time),
+  but all devices measure at the same time. The cycle time thus depends on the device with the most
+  channels instead of the total number of channels. Results are published as one timestamped snapshot per cycle.
+  A device that stops answering is skipped for the rest of the cycle and recovered (Ardoxy::startRecover) at the
+  start of the next one without blocking; while it is offline, its channels are reported with check 0 and the other
+  devices stay on schedule.
+  A result hook processes each channel (filter, PID step, display) as soon as its result is in, while the device
+  already measures its next channel. The duration of each stage is recorded for printTiming().
+*/
+
+#ifndef ArdoxyManager_h
+#define ArdoxyManager_h
+
+#include "Arduino.h"
+#include "Ardoxy.h"
+
+#ifndef ARDOXY_MAX_DEVICES
+#define ARDOXY_MAX_DEVICES 4                                                // FireSting devices per manager
+#endif
+#ifndef ARDOXY_MAX_CHANNELS
+#define ARDOXY_MAX_CHANNELS 16                                              // channels per manager (all devices)
+#endif
+
+// Stages timed by the manager (and ARDOXY_STAGE_FINISH by the sketch with timeStage())
+#define ARDOXY_STAGE_MEASURE 0                                              // one measure-and-read, from start to result
+#define ARDOXY_STAGE_PROCESS 1                                              // result hook, runs while the next channel is measured
+#define ARDOXY_STAGE_CYCLE 2                                                // startCycle() until the last result
+#define ARDOXY_STAGE_FINISH 3                                               // work after a cycle (logging, display, ...)
+#define ARDOXY_STAGES 4
+
+// Durations of one stage
+struct ArdoxyStageStats
+{
+  unsigned long count;                                                      // number of timed runs
+  unsigned long last;                                                       // duration of the last run [µs]
+  unsigned long min;                                                        // shortest run [µs]
+  unsigned long max;                                                        // longest run [µs]
+  unsigned long avg;                                                        // moving average (EWMA, weight 1/8) [µs]
+
+  void add(unsigned long us)
+  {
+    last = us;
+    if (count == 0 || us < min) {
+      min = us;
+    }
+    if (us > max) {
+      max = us;
+    }
+    avg = count ? avg - avg / 8 + us / 8 : us;
+    count++;
+  }
+};
+
+// Results of one acquisition cycle, in the order in which the channels were added
+struct ArdoxySnapshot
+{
+  unsigned long cycle;                                                      // number of the cycle (starts at 1)
+  unsigned long started;                                                    // ms timestamp of the cycle start
+  unsigned long completed;                                                  // ms timestamp when the last result arrived
+  byte count;                                                               // number of channels
+  ArdoxyResult results[ARDOXY_MAX_CHANNELS];                                // check is 1 for valid results
+};
+
+class ArdoxyManager
+{
+  public:
+    int addDevice(Ardoxy& device);
+    int addChannel(int device, int chan);
+    void startCycle();
+    bool poll();
+    bool busy();
+    const ArdoxySnapshot& snapshot();
+    void setTimeout(int timeout);
+    void setResultHook(void (*hook)(int slot, const ArdoxyResult& res));
+    void enableChannel(int slot, bool enable);
+    void timeStage(byte stage, unsigned long startedUs);
+    const ArdoxyStageStats& stageStats(byte stage);
+    void resetTiming();
+    void printTiming(Print& out);
+
+  private:
+    void startDevice(byte device);
+    void startNext(byte device);
+    Ardoxy* devices[ARDOXY_MAX_DEVICES];
+    byte nDevices = 0;
+    byte chanDevice[ARDOXY_MAX_CHANNELS];                                   // device of each channel slot
+    byte chanNumber[ARDOXY_MAX_CHANNELS];                                   // FireSting channel of each slot
+    byte nChannels = 0;
+    bool enabled[ARDOXY_MAX_CHANNELS];                                      // disabled slots are skipped (check 0)
+    int current[ARDOXY_MAX_DEVICES];                                        // slot each device is measuring (-1: not started, nChannels: done)
+    bool failed[ARDOXY_MAX_DEVICES];                                        // device did not answer in the last cycle
+    bool recovering[ARDOXY_MAX_DEVICES];                                    // device is being recovered before its first channel
+    unsigned long measStart[ARDOXY_MAX_DEVICES];                            // µs timestamp when the current channel was started
+    ArdoxySnapshot snaps[2] = {};                                           // published snapshot and the one being filled
+    byte front = 0;                                                         // index of the published snapshot
+    unsigned long cycles = 0;
+    bool active = false;
+    int measTimeout = 500;                                                  // timeout of one measure-and-read
+    void (*resultHook)(int slot, const ArdoxyResult& res) = 0;              // called with each result during the cycle
+    unsigned long cycleStartUs;                                             // µs timestamp of startCycle()
+    ArdoxyStageStats stages[ARDOXY_STAGES] = {};
+};
+
+#endif
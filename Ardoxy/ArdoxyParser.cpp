@@ -0,0 +1,79 @@
+/*
+  ArdoxyParser.cpp - Single-pass parser for FireSting replies and formatter for FireSting commands.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyParser.h>
+
+// Prepare for a new reply: command is the command that was sent (the FireSting echoes it without '\r'),
+// values following the echo are stored in dest (up to destSize values, further values are only counted as last())
+void ArdoxyParser::begin(const char command[], long values[], byte valuesSize)
+{
+  echo = command;
+  dest = values;
+  destSize = values ? valuesSize : 0;
+  nValues = 0;
+  pos = 0;
+  acc = 0;
+  lastValue = 0;
+  digits = 0;
+  negative = false;
+  echoDone = false;
+  malformed = false;
+}
+
+// True if the complete echo was received and all values are well-formed
+bool ArdoxyParser::valid()
+{
+  if (!echoDone && echo[pos] != '\r' && echo[pos] != '\0') {
+    return false;                                 // reply shorter than the echo
+  }
+  return !malformed;
+}
+
+// Number of values following the echo (may exceed the capacity of dest)
+byte ArdoxyParser::count()
+{
+  return nValues;
+}
+
+// Last value of the reply (e.g. the result of REA)
+long ArdoxyParser::last()
+{
+  return lastValue;
+}
+
+// Characters received so far
+int ArdoxyParser::length()
+{
+  return pos;
+}
+
+// Format a command "op arg1 arg2 ...\r" into buf, e.g. format(buf, 16, "RMR", {1, 3, 4, 2}, 4) -> "RMR 1 3 4 2\r"
+// Returns the length of the command, 0 if buf is too small
+byte ArdoxyParser::format(char buf[], byte bufSize, const char op[], const int args[], byte nArgs)
+{
+  byte n = 0;
+  while (*op) {
+    if (n + 2 >= bufSize) return 0;
+    buf[n++] = *op++;
+  }
+  for (byte i = 0; i < nArgs; i++) {
+    char digitBuf[10];                                                      // widest unsigned (32-bit) has 10 digits
+    byte nd = 0;
+    unsigned int v = args[i] < 0 ? 0u - (unsigned int)args[i] : (unsigned int)args[i];
+    do {
+      digitBuf[nd++] = '0' + v % 10;
+      v /= 10;
+    } while (v);
+    if (n + nd + (args[i] < 0) + 3 > bufSize) return 0;
+    buf[n++] = ' ';
+    if (args[i] < 0) buf[n++] = '-';
+    while (nd) {
+      buf[n++] = digitBuf[--nd];
+    }
+  }
+  buf[n++] = '\r';
+  buf[n] = '\0';
+  return n;
+}
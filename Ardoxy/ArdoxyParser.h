@@ -0,0 +1,109 @@
+/*
+  ArdoxyParser.h - Single-pass parser for FireSting replies and formatter for FireSting commands.
+  The parser is fed one received character at a time: it compares the echo of the command on the fly
+  and converts the space-separated integer values that follow into fixed-point longs (the FireSting
+  reports e.g. % air saturation x 1000), without buffering the reply and without libc parsing.
+*/
+
+#ifndef ArdoxyParser_h
+#define ArdoxyParser_h
+
+#include "Arduino.h"
+
+#define ARDOXY_MAX_DIGITS 9                                                 // longer numbers can't be valid FireSting values (and would overflow)
+
+class ArdoxyParser
+{
+  public:
+    void begin(const char command[], long dest[], byte destSize);
+    void feed(char c);
+    void finish();
+    bool valid();
+    byte count();
+    long last();
+    int length();
+    static byte format(char buf[], byte bufSize, const char op[], const int args[], byte nArgs);
+    static int centi(long milli);
+
+  private:
+    const char* echo;                                                       // command whose echo is expected (terminated by '\r')
+    long* dest;                                                             // values following the echo are stored here
+    byte destSize;                                                          // capacity of dest
+    byte nValues;                                                           // values stored in dest
+    int pos;                                                                // characters received so far
+    long acc;                                                               // value that is currently being parsed
+    long lastValue;                                                         // last complete value of the reply
+    byte digits;                                                            // digits in acc
+    bool negative;                                                          // acc has a leading minus
+    bool echoDone;                                                          // the complete echo has been received
+    bool malformed;                                                         // echo mismatch, bad character or overlong number
+};
+
+// feed() and finish() are inline: they run for every received character, also in builds without
+// link-time optimization
+
+// Complete the value that is currently being parsed (call after the end marker)
+inline void ArdoxyParser::finish()
+{
+  if (digits) {
+    lastValue = negative ? -acc : acc;
+    if (nValues < destSize) {
+      dest[nValues] = lastValue;
+    }
+    if (nValues < 255) {
+      nValues++;
+    }
+  } else if (negative) {
+    malformed = true;                             // lone minus
+  }
+  acc = 0;
+  digits = 0;
+  negative = false;
+}
+
+// Process one received character (without the end marker)
+inline void ArdoxyParser::feed(char c)
+{
+  pos++;
+  if (!echoDone) {
+    char e = echo[pos-1];
+    if (e != '\r' && e != '\0') {
+      if (c != e) {
+        malformed = true;                         // echo mismatch
+      }
+      return;
+    }
+    echoDone = true;                              // echo complete, c must separate the first value
+    if (c != ' ') {
+      malformed = true;                           // e.g. "MSR 12" is not the echo of "MSR 1"
+    }
+    return;
+  }
+
+  if (c >= '0' && c <= '9') {
+    if (digits == ARDOXY_MAX_DIGITS) {
+      malformed = true;
+      return;
+    }
+    acc = acc * 10 + (c - '0');
+    digits++;
+  } else if (c == '-' && digits == 0 && !negative) {
+    negative = true;
+  } else if (c == ' ') {
+    finish();
+  } else {
+    malformed = true;                             // garbled reply
+  }
+}
+
+// Fixed point x 1000 (as reported by the FireSting) to x 100, rounded and limited to 16 bit,
+// for the 16-bit values of ArdoxyLog and ArdoxyTelemetry
+inline int ArdoxyParser::centi(long milli)
+{
+  long c = (milli >= 0 ? milli + 5 : milli - 5) / 10;
+  if (c > 32767) return 32767;
+  if (c < -32767) return -32767;
+  return c;
+}
+
+#endif
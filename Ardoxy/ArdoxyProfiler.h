@@ -0,0 +1,272 @@
+/*
+  ArdoxyProfiler.h - Cycle-time budget of a control sketch.
+  Stages of the loop (serial, SD, LCD, valves, ...) are timed with a scoped timer (ARDOXY_PROFILE_STAGE) or
+  with stage(); each keeps its count, min, max and average. The lateness of each cycle start against its
+  due time is counted in a histogram of power-of-two bins, and every cycle that takes longer than the budget
+  is logged with the stage that took longest in it. print() dumps it all, e.g. on a serial command, so intervals
+  and channel counts can be sized from measured data.
+  Header only: with #define ARDOXY_PROFILE 0 before the #include, all calls compile to nothing. Take the stage
+  start times with ARDOXY_PROFILE_MICROS() instead of micros(), so that they are compiled out as well.
+*/
+
+#ifndef ArdoxyProfiler_h
+#define ArdoxyProfiler_h
+
+#include "Arduino.h"
+#include "ArdoxyManager.h"
+
+#ifndef ARDOXY_PROFILE
+#define ARDOXY_PROFILE 1                                                    // 0: remove the profiler at compile time
+#endif
+#ifndef ARDOXY_PROFILE_STAGES
+#define ARDOXY_PROFILE_STAGES 8                                             // stages per profiler
+#endif
+#ifndef ARDOXY_PROFILE_OVERRUNS
+#define ARDOXY_PROFILE_OVERRUNS 8                                           // last overruns kept in the log
+#endif
+#define ARDOXY_PROFILE_BINS 12                                              // lateness < 1 ms, < 2, < 4, ... < 1024, >= 1024 ms
+#define ARDOXY_PROFILE_NONE 0xFF                                            // no stage timed in the cycle
+
+#define ARDOXY_PROFILE_CAT2(a, b) a##b
+#define ARDOXY_PROFILE_CAT(a, b) ARDOXY_PROFILE_CAT2(a, b)
+
+// One cycle that exceeded the budget
+struct ArdoxyOverrun
+{
+  unsigned long at;                                                         // ms timestamp of the cycle start
+  unsigned long duration;                                                   // length of the cycle [ms]
+  unsigned long late;                                                       // lateness of the cycle start [ms]
+  byte stage;                                                               // longest stage in the cycle
+  unsigned long stageDuration;                                              // its duration [ms]
+};
+
+#if ARDOXY_PROFILE
+
+class ArdoxyProfiler
+{
+  public:
+    // budgetMs: longest cycle that keeps the schedule (e.g. the shortest interval)
+    // names: stage names in PROGMEM, 8 characters each (e.g. "serial  sd      lcd     "), or 0 for numbers
+    void begin(unsigned long budgetMs, const char* names=0)
+    {
+      budget = budgetMs;
+      stageNames = names;
+      reset();
+    }
+
+    // A cycle starts now, lateMs after it was due
+    void cycleStart(unsigned long lateMs)
+    {
+      cycleAt = millis();
+      cycleUs = micros();
+      cycleLate = lateMs;
+      inCycle = true;
+      worst = ARDOXY_PROFILE_NONE;
+      worstUs = 0;
+      lateness.add(lateMs * 1000);
+      byte bin = 0;
+      while (lateMs > 0 && bin < ARDOXY_PROFILE_BINS - 1) {
+        lateMs >>= 1;
+        bin++;
+      }
+      lateBins[bin]++;
+    }
+
+    // The cycle is complete: counts as an overrun if it took longer than the budget
+    void cycleEnd()
+    {
+      if (!inCycle) {
+        return;
+      }
+      inCycle = false;
+      unsigned long us = micros() - cycleUs;
+      cycles.add(us);
+      if (us / 1000 <= budget) {
+        return;
+      }
+      ArdoxyOverrun& o = overrunLog[nOverruns % ARDOXY_PROFILE_OVERRUNS];
+      o.at = cycleAt;
+      o.duration = us / 1000;
+      o.late = cycleLate;
+      o.stage = worst;
+      o.stageDuration = worstUs / 1000;
+      nOverruns++;
+    }
+
+    // Record the duration of a stage that started at startedUs (micros()) and ends now
+    void stage(byte st, unsigned long startedUs)
+    {
+      if (st >= ARDOXY_PROFILE_STAGES) {
+        return;
+      }
+      unsigned long us = micros() - startedUs;
+      stages[st].add(us);
+      if (inCycle && us >= worstUs) {
+        worst = st;
+        worstUs = us;
+      }
+    }
+
+    const ArdoxyStageStats& stageStats(byte st) {return stages[st < ARDOXY_PROFILE_STAGES ? st : 0];}
+    const ArdoxyStageStats& cycleStats() {return cycles;}
+    const ArdoxyStageStats& latenessStats() {return lateness;}
+    unsigned long lateCount(byte bin) {return bin < ARDOXY_PROFILE_BINS ? lateBins[bin] : 0;}
+    unsigned long overruns() {return nOverruns;}
+
+    // Overrun i (0: the most recent) of the last ARDOXY_PROFILE_OVERRUNS
+    const ArdoxyOverrun& overrun(byte i)
+    {
+      byte n = nOverruns < ARDOXY_PROFILE_OVERRUNS ? nOverruns : ARDOXY_PROFILE_OVERRUNS;
+      return overrunLog[(nOverruns - 1 - (i < n ? i : 0)) % ARDOXY_PROFILE_OVERRUNS];
+    }
+
+    void reset()
+    {
+      memset(stages, 0, sizeof(stages));
+      memset(&cycles, 0, sizeof(cycles));
+      memset(&lateness, 0, sizeof(lateness));
+      memset(lateBins, 0, sizeof(lateBins));
+      nOverruns = 0;
+      inCycle = false;
+    }
+
+    // Print the stages, cycles, lateness histogram and overrun log (times in ms)
+    void print(Print& out)
+    {
+      out.println(F("stage   count  min[ms]  avg[ms]  max[ms]"));
+      for (byte st = 0; st < ARDOXY_PROFILE_STAGES; st++) {
+        if (stages[st].count) {
+          printName(out, st);
+          printStats(out, stages[st]);
+        }
+      }
+      out.print(F("cycle   "));
+      printStats(out, cycles);
+      out.print(F("late    "));
+      printStats(out, lateness);
+      out.print(F("late[ms] <1:"));
+      out.print(lateBins[0]);
+      for (byte bin = 1; bin < ARDOXY_PROFILE_BINS; bin++) {
+        out.print(bin < ARDOXY_PROFILE_BINS - 1 ? F(" <") : F(" >="));
+        out.print(1UL << (bin < ARDOXY_PROFILE_BINS - 1 ? bin : bin - 1));
+        out.print(':');
+        out.print(lateBins[bin]);
+      }
+      out.println();
+      out.print(F("overruns (budget "));
+      out.print(budget);
+      out.print(F(" ms): "));
+      out.println(nOverruns);
+      if (nOverruns == 0) {
+        return;
+      }
+      out.println(F("at[s]  cycle[ms]  late[ms]  stage   stage[ms]"));
+      byte n = nOverruns < ARDOXY_PROFILE_OVERRUNS ? nOverruns : ARDOXY_PROFILE_OVERRUNS;
+      for (byte i = n; i-- > 0; ) {                                         // oldest first
+        const ArdoxyOverrun& o = overrun(i);
+        out.print(o.at / 1000);
+        out.print(' ');
+        out.print(o.duration);
+        out.print(' ');
+        out.print(o.late);
+        out.print(' ');
+        printName(out, o.stage);
+        out.println(o.stageDuration);
+      }
+    }
+
+  private:
+    void printName(Print& out, byte st)
+    {
+      if (st == ARDOXY_PROFILE_NONE) {
+        out.print(F("-       "));
+      } else if (stageNames) {
+        for (byte i = 0; i < 8; i++) {
+          out.write(pgm_read_byte(&stageNames[8 * st + i]));
+        }
+      } else {
+        out.print(st);
+        out.print(F("       "));
+      }
+    }
+
+    void printStats(Print& out, const ArdoxyStageStats& s)
+    {
+      out.print(s.count);
+      out.print(' ');
+      out.print(s.min / 1000.0);
+      out.print(' ');
+      out.print(s.avg / 1000.0);
+      out.print(' ');
+      out.println(s.max / 1000.0);
+    }
+
+    unsigned long budget = 0;                                               // ms
+    const char* stageNames = 0;                                             // PROGMEM, 8 characters per stage
+    ArdoxyStageStats stages[ARDOXY_PROFILE_STAGES] = {};
+    ArdoxyStageStats cycles = {};                                           // cycleStart() until cycleEnd()
+    ArdoxyStageStats lateness = {};                                         // lateness of the cycle starts [µs, ms resolution]
+    unsigned long lateBins[ARDOXY_PROFILE_BINS] = {};                       // histogram of the lateness
+    ArdoxyOverrun overrunLog[ARDOXY_PROFILE_OVERRUNS];                      // ring buffer of the last overruns
+    unsigned long nOverruns = 0;
+    unsigned long cycleAt;                                                  // ms timestamp of cycleStart()
+    unsigned long cycleUs;                                                  // µs timestamp of cycleStart()
+    unsigned long cycleLate;                                                // ms
+    byte worst = ARDOXY_PROFILE_NONE;                                       // longest stage of the current cycle
+    unsigned long worstUs = 0;
+    bool inCycle = false;
+};
+
+// Times the rest of the enclosing block as one stage
+class ArdoxyStageTimer
+{
+  public:
+    ArdoxyStageTimer(ArdoxyProfiler& p, byte st) : profiler(p), id(st), started(micros()) {}
+    ~ArdoxyStageTimer() {profiler.stage(id, started);}
+
+  private:
+    ArdoxyProfiler& profiler;
+    byte id;
+    unsigned long started;
+};
+
+#define ARDOXY_PROFILE_STAGE(profiler, stage) ArdoxyStageTimer ARDOXY_PROFILE_CAT(ardoxyStageTimer, __LINE__)(profiler, stage)
+#define ARDOXY_PROFILE_MICROS() micros()                                    // start time for stage()
+
+#else
+
+// Compiled out: same interface, no code and no data
+class ArdoxyProfiler
+{
+  public:
+    void begin(unsigned long, const char* =0) {}
+    void cycleStart(unsigned long) {}
+    void cycleEnd() {}
+    void stage(byte, unsigned long) {}
+    const ArdoxyStageStats& stageStats(byte) {return none();}
+    const ArdoxyStageStats& cycleStats() {return none();}
+    const ArdoxyStageStats& latenessStats() {return none();}
+    unsigned long lateCount(byte) {return 0;}
+    unsigned long overruns() {return 0;}
+    const ArdoxyOverrun& overrun(byte)
+    {
+      static const ArdoxyOverrun zero = {};
+      return zero;
+    }
+    void reset() {}
+    void print(Print& out) {out.println(F("profiler off (ARDOXY_PROFILE 0)"));}
+
+  private:
+    static const ArdoxyStageStats& none()
+    {
+      static const ArdoxyStageStats zero = {};
+      return zero;
+    }
+};
+
+#define ARDOXY_PROFILE_STAGE(profiler, stage)
+#define ARDOXY_PROFILE_MICROS() 0UL
+
+#endif
+
+#endif
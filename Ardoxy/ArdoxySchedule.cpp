@@ -0,0 +1,85 @@
+/*
+  ArdoxySchedule.cpp - DO regime from a table of breakpoints in program memory.
+*/
+
+#include <Arduino.h>
+#include <ArdoxySchedule.h>
+
+// table: breakpoints in PROGMEM, ascending in time; interpolate: false holds each setpoint until the next breakpoint
+ArdoxySchedule::ArdoxySchedule(const ArdoxyBreakpoint* table, byte count, bool interpolate)
+  : points(table), nPoints(count), linear(interpolate)
+{
+}
+
+// Start of the regime as epoch (e.g. toEpoch(2022, 3, 3) or RTC.now().unixtime())
+void ArdoxySchedule::begin(unsigned long startEpoch)
+{
+  start = startEpoch;
+  cursor = 0;
+  cached = false;
+}
+
+// Setpoint at the given time (epoch, e.g. RTC.now().unixtime())
+// Returns:
+// setpoint in % air saturation x 1000 (0 if the table is empty)
+long ArdoxySchedule::setpoint(unsigned long epoch)
+{
+  if (nPoints == 0) {
+    return 0;
+  }
+  if (cached && epoch == lastEpoch) {
+    return lastSetpoint;
+  }
+  unsigned long t = epoch > start ? epoch - start : 0;
+  while (cursor + 1 < nPoints && timeAt(cursor + 1) <= t) {               // usually once per breakpoint
+    cursor++;
+  }
+  while (cursor > 0 && timeAt(cursor) > t) {                                // clock was set back
+    cursor--;
+  }
+  long sp = setpointAt(cursor);
+  unsigned long t0 = timeAt(cursor);
+  if (linear && cursor + 1 < nPoints && t > t0) {
+    unsigned long t1 = timeAt(cursor + 1);
+    long sp1 = setpointAt(cursor + 1);
+    sp += (long long)(sp1 - sp) * (long long)(t - t0) / (long long)(t1 - t0);
+  }
+  lastEpoch = epoch;
+  lastSetpoint = sp;
+  cached = true;
+  return sp;
+}
+
+// True once the last breakpoint has passed (the setpoint stays constant from then on)
+bool ArdoxySchedule::finished(unsigned long epoch)
+{
+  return nPoints == 0 || (epoch >= start && epoch - start >= timeAt(nPoints - 1));
+}
+
+// Day of the regime, counted like Ardoxy::calcDays (the start day is day 1)
+int ArdoxySchedule::day(unsigned long epoch)
+{
+  return (long)(epoch / 86400UL) - (long)(start / 86400UL) + 1;
+}
+
+// Index of the last breakpoint that has passed at the time of the last setpoint() call
+byte ArdoxySchedule::segment()
+{
+  return cursor;
+}
+
+// Seconds since 1 January 1970 (as RTClib's DateTime::unixtime()), for dates from 1970 to 2105
+unsigned long ArdoxySchedule::toEpoch(int year, int month, int day, int hour, int minute, int second)
+{
+  return Ardoxy::daysFromCivil(year, month, day) * 86400UL + hour * 3600UL + minute * 60UL + second;
+}
+
+unsigned long ArdoxySchedule::timeAt(byte i)
+{
+  return pgm_read_dword(&points[i].time);
+}
+
+long ArdoxySchedule::setpointAt(byte i)
+{
+  return (int32_t)pgm_read_dword(&points[i].setpoint);                      // sign-extends where long has 64 bits
+}
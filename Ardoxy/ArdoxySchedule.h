@@ -0,0 +1,49 @@
+/*
+  ArdoxySchedule.h - DO regime from a table of breakpoints in program memory.
+  Each breakpoint is a time since the start of the regime (ARDOXY_AT(day, hour, minute)) and a setpoint in
+  % air saturation x 1000. Between two breakpoints, the setpoint is interpolated linearly (or held, with
+  step mode); before the first and after the last breakpoint, their setpoint applies. A cursor remembers
+  the current segment, so setpoint() only moves on when a breakpoint has passed - no calendar math per call.
+*/
+
+#ifndef ArdoxySchedule_h
+#define ArdoxySchedule_h
+
+#include "Arduino.h"
+#include "Ardoxy.h"
+
+// Time of a breakpoint in seconds after the start of the regime (day 0 is the start day)
+#define ARDOXY_AT(day, hour, minute) ((day) * 86400UL + (hour) * 3600UL + (minute) * 60UL)
+
+// One breakpoint, e.g. const ArdoxyBreakpoint regime[] PROGMEM = {{ARDOXY_AT(0, 0, 0), 100000}, ...};
+struct ArdoxyBreakpoint
+{
+  uint32_t time;                                                            // s after the start, ascending
+  int32_t setpoint;                                                         // % air saturation x 1000 (fixed width for pgm_read_dword)
+};
+
+class ArdoxySchedule
+{
+  public:
+    ArdoxySchedule(const ArdoxyBreakpoint* table, byte count, bool interpolate=true);
+    void begin(unsigned long startEpoch);
+    long setpoint(unsigned long epoch);
+    bool finished(unsigned long epoch);
+    int day(unsigned long epoch);
+    byte segment();
+    static unsigned long toEpoch(int year, int month, int day, int hour=0, int minute=0, int second=0);
+
+  private:
+    unsigned long timeAt(byte i);
+    long setpointAt(byte i);
+    const ArdoxyBreakpoint* points;                                         // table in PROGMEM
+    byte nPoints;
+    bool linear;
+    unsigned long start = 0;                                                // epoch of the regime start
+    byte cursor = 0;                                                        // last breakpoint at or before the current time
+    unsigned long lastEpoch = 0;                                            // time of the cached setpoint
+    long lastSetpoint = 0;
+    bool cached = false;
+};
+
+#endif
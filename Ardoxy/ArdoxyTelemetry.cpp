@@ -0,0 +1,85 @@
+/*
+  ArdoxyTelemetry.cpp - Compact binary telemetry frames for live plotting and logging on a host.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyTelemetry.h>
+
+// Send one frame with count values (fixed point, e.g. centi() of a DO value) and the current millis()
+// Returns:
+// number of bytes written (with COBS overhead and delimiters)
+// 0 if count exceeds ARDOXY_TELEMETRY_VALUES
+int ArdoxyTelemetry::send(const int values[], byte count)
+{
+  if (count > ARDOXY_TELEMETRY_VALUES) {
+    return 0;
+  }
+  byte frame[ARDOXY_TELEMETRY_FRAME];
+  byte encoded[ARDOXY_TELEMETRY_FRAME + 3];
+  unsigned long now = millis();
+  int len = 0;
+  frame[len++] = seq & 0xFF;
+  frame[len++] = seq >> 8;
+  for (byte i = 0; i < 4; i++) {
+    frame[len++] = (now >> (8 * i)) & 0xFF;
+  }
+  frame[len++] = count;
+  for (byte k = 0; k < count; k++) {
+    frame[len++] = values[k] & 0xFF;
+    frame[len++] = (values[k] >> 8) & 0xFF;
+  }
+  unsigned int crc = crc16(frame, len);
+  frame[len++] = crc & 0xFF;
+  frame[len++] = crc >> 8;
+  encoded[0] = 0;                                                           // separates the frame from text sent before
+  int n = 1 + encode(frame, len, &encoded[1]);
+  encoded[n++] = 0;                                                         // frame delimiter
+  seq++;
+  return out->write(encoded, n);
+}
+
+// Sequence number of the next frame (a gap on the host means lost frames)
+unsigned int ArdoxyTelemetry::sequence()
+{
+  return seq;
+}
+
+// CRC-16/CCITT (polynomial 0x1021, start value 0xFFFF)
+unsigned int ArdoxyTelemetry::crc16(const byte data[], int length)
+{
+  unsigned int crc = 0xFFFF;
+  for (int i = 0; i < length; i++) {
+    crc ^= (unsigned int)data[i] << 8;
+    for (byte b = 0; b < 8; b++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc & 0xFFFF;
+}
+
+// COBS: replace every 0 byte by the distance to the next one, so that 0 only appears as delimiter
+// encoded[] needs length + 1 + length / 254 bytes
+// Returns the encoded length (without delimiter)
+int ArdoxyTelemetry::encode(const byte data[], int length, byte encoded[])
+{
+  int codePos = 0;
+  int pos = 1;
+  byte code = 1;
+  for (int i = 0; i < length; i++) {
+    if (data[i] == 0) {
+      encoded[codePos] = code;
+      codePos = pos++;
+      code = 1;
+      continue;
+    }
+    encoded[pos++] = data[i];
+    code++;
+    if (code == 0xFF) {                                                     // block of 254 bytes without 0
+      encoded[codePos] = code;
+      codePos = pos++;
+      code = 1;
+    }
+  }
+  encoded[codePos] = code;
+  return pos;
+}
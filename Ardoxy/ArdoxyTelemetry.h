@@ -0,0 +1,40 @@
+/*
+  ArdoxyTelemetry.h - Compact binary telemetry frames for live plotting and logging on a host.
+  A frame holds a sequence number, a ms timestamp and up to ARDOXY_TELEMETRY_VALUES 16-bit fixed-point values
+  (e.g. DO and temperature x 100, valve opening time in ms), followed by a CRC-16/CCITT. It is COBS-encoded
+  and enclosed in 0 bytes, so a receiver finds the next frame after lost or garbled bytes, and text printed
+  between two frames (e.g. error messages) does not corrupt them. ARDOXY_TELEMETRY_NONE marks a missing value.
+  extras/host/telemetry_decode.cpp converts the frames to CSV or to lines for a serial plotter.
+
+  Frame (before COBS, little endian): sequence (2), millis (4), count (1), values (2 each), CRC (2)
+*/
+
+#ifndef ArdoxyTelemetry_h
+#define ArdoxyTelemetry_h
+
+#include "Arduino.h"
+#include "ArdoxyParser.h"
+
+#ifndef ARDOXY_TELEMETRY_VALUES
+#define ARDOXY_TELEMETRY_VALUES 16                                          // values per frame
+#endif
+#define ARDOXY_TELEMETRY_HEADER 7                                           // sequence, millis, count
+#define ARDOXY_TELEMETRY_FRAME (ARDOXY_TELEMETRY_HEADER + 2 * ARDOXY_TELEMETRY_VALUES + 2)
+#define ARDOXY_TELEMETRY_NONE -32768                                        // no value (centi() never returns it)
+
+class ArdoxyTelemetry
+{
+  public:
+    ArdoxyTelemetry(Print& port) : out(&port) {}
+    int send(const int values[], byte count);
+    unsigned int sequence();
+    static int centi(long milli) {return ArdoxyParser::centi(milli);}       // x 1000 to x 100, see ArdoxyParser::centi()
+    static unsigned int crc16(const byte data[], int length);
+    static int encode(const byte data[], int length, byte encoded[]);
+
+  private:
+    Print* out;
+    unsigned int seq = 0;                                                   // sequence number of the next frame
+};
+
+#endif
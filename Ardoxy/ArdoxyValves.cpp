@@ -0,0 +1,160 @@
+/*
+  ArdoxyValves.cpp - Non-blocking scheduler for solenoid valves on relay pins.
+*/
+
+#include <Arduino.h>
+#include <ArdoxyValves.h>
+
+// Register a valve: the pin is set up as output and the valve closed
+// openLevel is the pin level that opens the valve (LOW for most relay modules)
+// Returns the valve index, -1 if ARDOXY_MAX_VALVES is reached
+int ArdoxyValves::addValve(int pin, byte openLevel)
+{
+  if (nValves >= ARDOXY_MAX_VALVES) {
+    return -1;
+  }
+  pins[nValves] = pin;
+  openLevels[nValves] = openLevel;
+  heapPos[nValves] = -1;
+  pinMode(pin, OUTPUT);
+  write(nValves, false);
+  nValves++;
+  return nValves - 1;
+}
+
+// Open a valve for duration ms (0 closes it). An open valve gets the new deadline.
+void ArdoxyValves::open(int valve, unsigned long duration)
+{
+  if (valve < 0 || valve >= nValves) {
+    return;
+  }
+  if (duration == 0) {
+    close(valve);
+    return;
+  }
+  deadlines[valve] = millis() + duration;
+  if (heapPos[valve] < 0) {
+    heap[nOpen] = valve;
+    heapPos[valve] = nOpen;
+    nOpen++;
+    write(valve, true);
+    siftUp(heapPos[valve]);
+  } else {
+    siftUp(heapPos[valve]);
+    siftDown(heapPos[valve]);
+  }
+}
+
+// Close a valve now
+void ArdoxyValves::close(int valve)
+{
+  if (valve < 0 || valve >= nValves) {
+    return;
+  }
+  if (heapPos[valve] >= 0) {
+    removeAt(heapPos[valve]);
+  }
+  write(valve, false);
+}
+
+// Close all valves now (e.g. on an alarm)
+void ArdoxyValves::closeAll()
+{
+  for (byte v = 0; v < nValves; v++) {
+    heapPos[v] = -1;
+    write(v, false);
+  }
+  nOpen = 0;
+}
+
+// Close all valves whose deadline has passed
+// Returns the number of valves that were closed
+int ArdoxyValves::update()
+{
+  int closed = 0;
+  unsigned long now = millis();
+  while (nOpen && (long)(now - deadlines[heap[0]]) >= 0) {
+    byte valve = heap[0];
+    removeAt(0);
+    write(valve, false);
+    closed++;
+  }
+  return closed;
+}
+
+bool ArdoxyValves::isOpen(int valve)
+{
+  return valve >= 0 && valve < nValves && heapPos[valve] >= 0;
+}
+
+// ms until an open valve closes, 0 if it is closed
+unsigned long ArdoxyValves::remaining(int valve)
+{
+  if (!isOpen(valve)) {
+    return 0;
+  }
+  long left = (long)(deadlines[valve] - millis());
+  return left > 0 ? left : 0;
+}
+
+int ArdoxyValves::openCount()
+{
+  return nOpen;
+}
+
+void ArdoxyValves::write(byte valve, bool opened)
+{
+  digitalWrite(pins[valve], opened ? openLevels[valve] : !openLevels[valve]);
+}
+
+// Deadline comparison that survives the millis() overflow
+bool ArdoxyValves::earlier(byte a, byte b)
+{
+  return (long)(deadlines[heap[a]] - deadlines[heap[b]]) < 0;
+}
+
+void ArdoxyValves::swap(byte i, byte j)
+{
+  byte t = heap[i];
+  heap[i] = heap[j];
+  heap[j] = t;
+  heapPos[heap[i]] = i;
+  heapPos[heap[j]] = j;
+}
+
+void ArdoxyValves::siftUp(byte i)
+{
+  while (i > 0 && earlier(i, (i - 1) / 2)) {
+    swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+void ArdoxyValves::siftDown(byte i)
+{
+  while (true) {
+    byte smallest = i;
+    byte l = 2 * i + 1;
+    byte r = 2 * i + 2;
+    if (l < nOpen && earlier(l, smallest)) smallest = l;
+    if (r < nOpen && earlier(r, smallest)) smallest = r;
+    if (smallest == i) return;
+    swap(i, smallest);
+    i = smallest;
+  }
+}
+
+// Remove the valve at heap position i
+void ArdoxyValves::removeAt(byte i)
+{
+  heapPos[heap[i]] = -1;
+  nOpen--;
+  if (i == nOpen) {
+    return;
+  }
+  byte moved = heap[nOpen];
+  heap[i] = moved;
+  heapPos[moved] = i;
+  siftUp(i);
+  siftDown(heapPos[moved]);
+}
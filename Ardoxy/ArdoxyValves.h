@@ -0,0 +1,45 @@
+/*
+  ArdoxyValves.h - Non-blocking scheduler for solenoid valves on relay pins.
+  open(valve, duration) opens a valve and returns immediately; update() closes every valve whose
+  deadline has passed. The deadlines are kept in a min-heap, so update() only looks at the earliest one.
+  Call update() as often as possible from loop() - measurements and valve operation then overlap.
+*/
+
+#ifndef ArdoxyValves_h
+#define ArdoxyValves_h
+
+#include "Arduino.h"
+
+#ifndef ARDOXY_MAX_VALVES
+#define ARDOXY_MAX_VALVES 16
+#endif
+
+class ArdoxyValves
+{
+  public:
+    int addValve(int pin, byte openLevel=LOW);
+    void open(int valve, unsigned long duration);
+    void close(int valve);
+    void closeAll();
+    int update();
+    bool isOpen(int valve);
+    unsigned long remaining(int valve);
+    int openCount();
+
+  private:
+    void write(byte valve, bool opened);
+    void siftUp(byte i);
+    void siftDown(byte i);
+    void removeAt(byte i);
+    void swap(byte i, byte j);
+    bool earlier(byte a, byte b);
+    byte pins[ARDOXY_MAX_VALVES];
+    byte openLevels[ARDOXY_MAX_VALVES];                                     // pin level that opens the valve
+    unsigned long deadlines[ARDOXY_MAX_VALVES];                             // ms timestamp when the valve closes
+    int8_t heapPos[ARDOXY_MAX_VALVES];                                      // position in heap, -1 if closed
+    byte heap[ARDOXY_MAX_VALVES];                                           // open valves, earliest deadline first
+    byte nValves = 0;
+    byte nOpen = 0;
+};
+
+#endif
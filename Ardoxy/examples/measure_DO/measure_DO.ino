@@ -42,13 +42,13 @@ Ardoxy ardoxy(mySer);
 void setup() {
   Serial.begin(19200);
   delay(300);
-  Serial.println("---------------- Ardoxy measurement example ----------------");
+  Serial.println(F("---------------- Ardoxy measurement example ----------------"));
   ardoxy.begin();
-  Serial.println("FireSting channel: 1");
-  Serial.print("Measurement interval (ms): ");
+  Serial.println(F("FireSting channel: 1"));
+  Serial.print(F("Measurement interval (ms): "));
   Serial.println(sampInterval);
-  Serial.println("Send \"1\" to start measurement and \"0\" to end measurement.");
-  Serial.println("------------------------------------------------------------");
+  Serial.println(F("Send \"1\" to start measurement and \"0\" to end measurement."));
+  Serial.println(F("------------------------------------------------------------"));
 
 }
 
@@ -58,11 +58,11 @@ void loop() {
     switch(Serial.read()){
       case '1':
           startTrigger = true;
-          Serial.println("started");
+          Serial.println(F("started"));
           break;
       case '0':
           startTrigger = false;
-          Serial.print("stopped");
+          Serial.print(F("stopped"));
           break;
     }
   }
@@ -70,12 +70,12 @@ void loop() {
   if (startTrigger){
     loopStart = millis();                     // get time at beginning of loop
     check = ardoxy.measureSeq(1);
-    Serial.print("Measurement status: ");
+    Serial.print(F("Measurement status: "));
     Serial.println(check);
     delay(20);
     result = ardoxy.readout(DOReadCom);
     resultFloat = result/1000.00;
-    Serial.print("Dissolved oxygen: ");
+    Serial.print(F("Dissolved oxygen: "));
     Serial.println(resultFloat);
     elapsed = millis()-loopStart;
     delay(sampInterval - elapsed);
@@ -20,6 +20,8 @@
   Download SerialPlot and use the configuration file (*.ini) from the Ardoxy github repository.
   Import the settings in SerialPlot using File>>Load Settings
   Or simply read the values from the serial monitor.
+  With binaryTelemetry = true, the values are sent as compact binary frames (ArdoxyTelemetry). Decode them on
+  the computer with extras/host/telemetry_decode.cpp (-p -s 100,100,1000 for the SerialPlot format).
 
   created 11 November 2021
   last revised 3 March 2022
@@ -30,6 +32,7 @@
 #include <Ardoxy.h>
 #include <SoftwareSerial.h>
 #include <PID_v1.h>
+#include <ArdoxyTelemetry.h>
 
 //#######################################################################################
 //###                              General settings                                   ###
@@ -38,6 +41,7 @@
 // Set experimental conditions
 unsigned long sampInterval = 5000;                    // sampling interval in ms (due to the duration of the measurement and communication, use interval > 1000 msec)
 double airSatThreshold = 40.00;                       // target air saturation value
+const bool binaryTelemetry = false;                   // true: binary frames instead of text lines
 unsigned long experimentDuration = 20 * 60 * 1000UL;  // duration for controlled DO in ms
 
 // Define pins
@@ -89,6 +93,8 @@ double output;                              // holds output that was calculated
 PID valvePID(&DOFloat, &output, &airSatThreshold, Kp, Ki, Kd, REVERSE);
 SoftwareSerial mySer(RX, TX);
 Ardoxy ardoxy(mySer);
+ArdoxyTelemetry telemetry(Serial);
+int frameValues[3];                         // DO and temperature x 100, opening time in ms
 
 
 //#######################################################################################
@@ -111,15 +117,15 @@ void setup() {
   digitalWrite(relayPin, closed);
 
   // Print experimental conditions
-  Serial.println("------------ Ardoxy measure and control example ------------");
-  Serial.println("FireSting channel: 1");
-  Serial.print("Measurement interval (ms): ");
+  Serial.println(F("------------ Ardoxy measure and control example ------------"));
+  Serial.println(F("FireSting channel: 1"));
+  Serial.print(F("Measurement interval (ms): "));
   Serial.println(sampInterval);
-  Serial.print(" Air saturation threshold (% air sat.): ");
+  Serial.print(F(" Air saturation threshold (% air sat.): "));
   Serial.println(airSatThreshold);
-  Serial.println("Use the SerialPlot software to plot DO and temperature");
-  Serial.println("Send \"1\" to start measurement and \"0\" to end measurement.");
-  Serial.println("------------------------------------------------------------");
+  Serial.println(F("Use the SerialPlot software to plot DO and temperature"));
+  Serial.println(F("Send \"1\" to start measurement and \"0\" to end measurement."));
+  Serial.println(F("------------------------------------------------------------"));
 }
 
 
@@ -130,7 +136,7 @@ void loop() {
       case '1':
           startTrigger = true;
           ardoxy.begin();                                 // Start serial communication with FireSting
-          Serial.println("DO_air_sat;Temp_deg_C;Open_time");
+          Serial.println(F("DO_air_sat;Temp_deg_C;Open_time"));
           // Define time points for decrease end and trial end
           progStart = millis();
           progEnd = progStart + experimentDuration;
@@ -138,7 +144,7 @@ void loop() {
       case '0':
           startTrigger = false;
           ardoxy.end();
-          Serial.println("Stopped");
+          Serial.println(F("Stopped"));
           digitalWrite(relayPin, closed);
           break;
     }
@@ -164,11 +170,19 @@ void loop() {
         valvePID.Compute();
 
         // Print to serial
-        Serial.print(DOFloat);
-        Serial.print(";");
-        Serial.print(tempFloat);
-        Serial.print(";");
-        Serial.println(round(output*200/1000));
+        if (binaryTelemetry) {
+          long openTime = lround(output*200);
+          frameValues[0] = ArdoxyTelemetry::centi(DOInt);
+          frameValues[1] = ArdoxyTelemetry::centi(tempInt);
+          frameValues[2] = openTime < 32767 ? openTime : 32767;
+          telemetry.send(frameValues, 3);
+        } else {
+          Serial.print(DOFloat);
+          Serial.print(F(";"));
+          Serial.print(tempFloat);
+          Serial.print(F(";"));
+          Serial.println(round(output*200/1000));
+        }
 
         // operate solenoid
         if (output*200 < sampInterval) {        // if the opening time is smaller than the loop duration...
@@ -195,13 +209,13 @@ void loop() {
       }  
       else {       // If the measurement returns with an error
         digitalWrite(relayPin, closed);
-        Serial.println("Com error. Check connections and send \"1\" to restart.");
+        Serial.println(F("Com error. Check connections and send \"1\" to restart."));
         startTrigger = false;
       }
     }
     else {
       digitalWrite(relayPin, closed);
-      Serial.println("End of experiment. Arduino stopps. Send \"1\" to re-start.");
+      Serial.println(F("End of experiment. Arduino stopps. Send \"1\" to re-start."));
       ardoxy.end();
       startTrigger = false;
     }
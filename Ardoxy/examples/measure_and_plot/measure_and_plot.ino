@@ -16,6 +16,8 @@
   The software:
   Download SerialPlot and use the configuration file (*.ini) from the Ardoxy github repository.
   Import the settings in SerialPlot using File>>Load Settings
+  With binaryTelemetry = true, the values are sent as compact binary frames (ArdoxyTelemetry). Decode them on
+  the computer with extras/host/telemetry_decode.cpp (-p -s 100 for the SerialPlot format).
 
   created 11 November 2021
   last revised 3 March 2022
@@ -25,9 +27,11 @@
 
 #include <Ardoxy.h>
 #include <SoftwareSerial.h>
+#include <ArdoxyTelemetry.h>
 
 // Set sampling interval in ms (due to the duration of the measurement and communication, use interval > 1000 msec)
 unsigned long sampInterval = 5000;
+const bool binaryTelemetry = false;         // true: binary frames instead of text lines
 
 // Define variables
 long DOInt, tempInt;                        // for measurement result
@@ -42,18 +46,20 @@ unsigned long loopStart, elapsed;           // ms timestamp of beginning and end
 // Initiate connection via SoftwareSerial and create Ardoxy instance
 SoftwareSerial mySer(10, 9);
 Ardoxy ardoxy(mySer);
+ArdoxyTelemetry telemetry(Serial);          // binary frames with sequence number and timestamp
+int frameValues[2];                         // DO and temperature x 100
 
 void setup() {
   Serial.begin(19200);
   delay(100);
-  Serial.println("-------------- Ardoxy measure and plot example -------------");
+  Serial.println(F("-------------- Ardoxy measure and plot example -------------"));
   ardoxy.begin();
-  Serial.println("FireSting channel: 1");
-  Serial.print("Measurement interval (ms): ");
+  Serial.println(F("FireSting channel: 1"));
+  Serial.print(F("Measurement interval (ms): "));
   Serial.println(sampInterval);
-  Serial.println("Use the SerialPlot software to plot DO and temperature");
-  Serial.println("Send \"1\" to start measurement and \"0\" to end measurement.");
-  Serial.println("------------------------------------------------------------");
+  Serial.println(F("Use the SerialPlot software to plot DO and temperature"));
+  Serial.println(F("Send \"1\" to start measurement and \"0\" to end measurement."));
+  Serial.println(F("------------------------------------------------------------"));
 }
 
 void loop() {
@@ -62,7 +68,7 @@ void loop() {
     switch(Serial.read()){
       case '1':
           startTrigger = true;
-          Serial.println("DO_air_sat;Temp_deg_C");
+          Serial.println(F("DO_air_sat;Temp_deg_C"));
           break;
       case '0':
           startTrigger = false;
@@ -82,15 +88,21 @@ void loop() {
       delay(20);
       DOFloat = DOInt / 1000.00;              // convert to floating point number
       tempFloat = tempInt / 1000.00;          // convert to floating point number
-      Serial.print(DOFloat);                  // print to serial
-      Serial.print(";");
-      Serial.println(tempFloat);
+      if (binaryTelemetry) {
+        frameValues[0] = ArdoxyTelemetry::centi(DOInt);
+        frameValues[1] = ArdoxyTelemetry::centi(tempInt);
+        telemetry.send(frameValues, 2);
+      } else {
+        Serial.print(DOFloat);                // print to serial
+        Serial.print(F(";"));
+        Serial.println(tempFloat);
+      }
       elapsed = millis()-loopStart;
       delay(sampInterval - elapsed);          // wait for next loop iteration
     }
     else {
-      Serial.println("Com error.");
-      Serial.println("Check connection with FireSting and send \"1\" to restart measurement.");      
+      Serial.println(F("Com error."));
+      Serial.println(F("Check connection with FireSting and send \"1\" to restart measurement."));      
       startTrigger = false;
     }
   }
@@ -2,10 +2,24 @@
 /*
   Ardoxy example - measure and control 4 channels via solenoids 
   
-  Trigger a measurement sequence (DO, temperature, air pressure) and read out the results. 
+  Trigger a measurement sequence (DO, temperature, air pressure) and read out the results. One temperature
+  sensor serves all tanks: temperature and air pressure are measured at most every tempMaxAge, the other
+  channels take faster DO-only measurements.
   Display on LCD and store on SD card.
+  The measurement runs in the background (ArdoxyManager): each channel is processed (oversampling filter,
+  PID step, valve) while the FireSting already measures the next one, and logging and display follow
+  right after the last channel. With showTiming = true, the duration of each stage is printed every cycle.
+  Channels marked in scheduled[] follow the DO regime in regimeTable (e.g. a hypoxia acclimation that lowers
+  the air saturation step by step over several weeks) instead of their fixed threshold.
+  With adaptiveInterval = true, each channel is measured between minInterval and maxInterval: often while
+  its DO changes fast or is far from the threshold (e.g. after a threshold step), at most every sampleInterval
+  while N2 is bubbled, and rarely while the tank is stable.
+  Below lowDOThreshold, a channel raises a low DO alarm (ArdoxyAlarm): its N2 valve stays closed and its air
+  valve (if any) opens until DO has been above the threshold + hysteresis for alarmRecovery. The other channels
+  are measured, logged and controlled meanwhile. The alarm stays marked with "!" on the LCD until the SELECT
+  button is pressed.
   Set desired DO level by opening a solenoid valve. 
-  Opening time is calculated with PID library.
+  Opening time is calculated by an integer PID controller (ArdoxyControl).
   
   Oxygen sensor is calbrated using the Pyro Oxygen Logger Software.
   
@@ -22,6 +36,13 @@
   The software:
   No software needed, values are stored on SD card, or
   simply read the values from the serial monitor or LCD display
+  With #define BINARY_LOG 1, the values are stored in a compact binary file (.bin) that is written in
+  512-byte blocks; extras/host/log_decode.cpp converts it to the usual .csv file
+  With captureSerial = true, every byte exchanged with the FireSting is recorded with its time in capture.bin;
+  extras/host/replay.cpp runs such a capture through the library again to reproduce a failing session
+  Send "p" on the serial monitor to print the cycle-time budget (ArdoxyProfiler): the duration of each stage of
+  the loop (min, average, max), how late the cycles started, and the last cycles that took longer than the
+  shortest interval with their longest stage. "r" resets it. #define ARDOXY_PROFILE 0 compiles it out.
 
   created 11 November 2021
   last revised: 3 March 2022
@@ -30,13 +51,26 @@
 */
 
 #include <Ardoxy.h>
-#include <PID_v1.h>
+#include <ArdoxyManager.h>
+#include <ArdoxyValves.h>
+#include <ArdoxyLog.h>
+#include <ArdoxyFilter.h>
+#include <ArdoxyControl.h>
+#include <ArdoxySchedule.h>
+#include <ArdoxyInterval.h>
+#include <ArdoxyAlarm.h>
+#include <ArdoxyTelemetry.h>
+#include <ArdoxyCapture.h>
+//#define ARDOXY_PROFILE 0                            // uncomment to remove the profiler
+#include <ArdoxyProfiler.h>
+#include <EEPROM.h>
 #include <SdFat.h>
 #include <Wire.h>
 #include "RTClib.h"
 #include <Adafruit_RGBLCDShield.h>
 #include <utility/Adafruit_MCP23017.h>
 #define WHITE 0x7                                     // LCD color code
+#define RED 0x1                                       // LCD color code during a low DO alarm
 
 
 //#######################################################################################
@@ -46,15 +80,38 @@
 //#######################################################################################
 
 //# Set experimental conditions #
-const int channelNumber = 4;                                                                  // total number of measurement channels
-long int samples = 1;                                                                         // number of measurements that are averaged to one air saturation value 
+constexpr byte channelNumber = 4;                                                             // total number of measurement channels
+long int samples = 1;                                                                         // max. number of measurements that are averaged to one air saturation value 
                                                                                               // to reduce sensor fluctuation (oversampling)
+long maxError = 50;                                                                           // oversampling stops early when the standard error of the mean is below
+                                                                                              // this value (% air saturation x 1000), after at least 3 measurements
+long spikeLimit = 5000;                                                                       // measurements deviating from the median by more than this are discarded
 char tankID[channelNumber][6] = {"A", "B", "C", "D"};                                         // IDs assigned to the channels in the order of the channelArray
 char tempID[6] = {"B"};                                                                       // tanks where the temperature sensors are placed (1 per sensor)
 long sampleInterval = 30 * 1000UL;                                                            // measurement and control interval in second
+unsigned long tempMaxAge = 60 * 1000UL;                                                       // measure temperature and air pressure at most this often (0: with every channel)
+const bool adaptiveInterval = true;                                                           // true: the interval of each channel adapts to its DO, false: sampleInterval
+const long minInterval = 10 * 1000UL;                                                         // shortest adaptive interval
+const long maxInterval = 120 * 1000UL;                                                        // longest adaptive interval
+const long rateLimit = 1000;                                                                  // measure more often when DO changes by 1 % air saturation per minute or more
+const long errorLimit = 5000;                                                                 // or when it is 5 % air saturation or more away from the threshold
 double airSatThreshold[channelNumber] = {100.0, 100.0, 100.0, 15.0};                          // air saturation threshold including first decimal                            
-double lowDOThreshold = 7.0;                                                                  // threshold for low oxygen that causes the program to do something
+double lowDOThreshold = 7.0;                                                                  // threshold for low oxygen that raises an alarm
+double lowDOHysteresis = 3.0;                                                                 // the alarm recovers at lowDOThreshold + lowDOHysteresis
+const unsigned long alarmRecovery = 1200 * 1000UL;                                            // time above that before N2 control resumes
 int channelArray[channelNumber] = {1, 2, 3, 4};                                               // measurement channels from firesting devices 1 and 2 in that order
+#define BINARY_LOG 0                                                                          // 1: binary logfile (fewer and larger SD writes, 512 bytes of RAM), 0: .csv logfile
+const bool scheduled[channelNumber] = {false, false, false, false};                         // true: the threshold of this channel follows regimeTable
+const int regimeStart[3] = {2022, 3, 3};                                                      // start date of the regime (year, month, day), day 1 of the regime
+const ArdoxyBreakpoint regimeTable[] PROGMEM = {                                              // (time after the start, threshold x 1000), linear in between
+  {ARDOXY_AT(0, 0, 0), 100000},                                                               // 7 days of acclimation at full air saturation,
+  {ARDOXY_AT(7, 0, 0), 100000},                                                               // then lowered to 15 % over two weeks
+  {ARDOXY_AT(21, 0, 0), 15000},
+};
+const bool binaryTelemetry = false;                                                           // true: one binary frame per cycle on the serial monitor port instead of text
+                                                                                              // (temperature, DO of each channel, opening times; see extras/host/telemetry_decode.cpp)
+const bool captureSerial = false;                                                             // true: record the FireSting traffic to capture.bin on the SD card (see extras/host/replay.cpp)
+const bool showTiming = false;                                                                // true: print the duration of measurement, processing and logging every cycle
 
 //# Set the RTC? #
 const int setRTC = 1;                                                                         // upload this sketch once with setRTC = 1 to set the clock to the time
@@ -62,27 +119,28 @@ const int setRTC = 1;
                                                                                               
 
 //# Define pins #
-int relayPin[channelNumber] = {46, 48, 50, 52};                                               // pins for relay operation ***ADAPT THIS TO FIT YOUR WIRING***
+constexpr byte relayPin[channelNumber] = {46, 48, 50, 52};                                    // pins for relay operation ***ADAPT THIS TO FIT YOUR WIRING***
+const byte airPin[channelNumber] = {0, 0, 0, 0};                                              // pins of air valves that open during a low DO alarm (0: none)
 const int chipSelect = 10;                                                                    // chip pin for SD card (UNO: 4; MEGA: 53, Adafruit shield: 10)
 
 
 //#######################################################################################
 //###                                PID settings                                     ###
 //### The arduino operates solenoid valves through a relay module to bubble N2 into   ###
-//### the tanks. It calculates a time interval using the PIDlibrary (by Brett         ###
-//### Beauregard). TEST THE SETTINGS FOR PID CONTROL BEFORE YOU USE THIS SYSTEM!!     ###
+//### the tanks. It calculates a time interval with ArdoxyControl (integer version of ###
+//### the PID library by Brett Beauregard). TEST THE SETTINGS FOR PID CONTROL BEFORE  ###
+//### YOU USE THIS SYSTEM!!                                                           ###
 //### If you're not sure, replace the PID control with a simpler solution             ###
 //### (e.g. bubble N2 for 10 sec if there's a large oxygen difference etc.).          ###
 //### To control for stress due to bubbling, compressed air is bubbled into control   ###
 //### tanks.                                                                          ###
 //#######################################################################################
 
-double Kp[channelNumber] = {10, 10, 10, 10};                    // coefficient for proportional control
-double Ki[channelNumber] = {1, 1, 1, 1};                        // coefficient for integrative control
-double Kd[channelNumber] = {1, 1, 1, 1};                        // coefficient for differential control
-const int windowSize = 75;                                       // The PID will calculate an output between 0 and 75.
-                                                                // This will be multiplied by 200 to ensure a minimum opening time of 200 msec. 
-                                                                // E.g. output = 1 -> opening time 200 msec; output 50 -> opening time 10,000 msec
+const long Kp[channelNumber] = {2000, 2000, 2000, 2000};        // proportional control: ms opening time per % air saturation above the threshold
+const long Ki[channelNumber] = {200, 200, 200, 200};            // integrative control: ms per (% air saturation x s)
+const long Kd[channelNumber] = {200, 200, 200, 200};            // differential control: ms per (% air saturation / s)
+const long maxOpening = 15000;                                  // The PID will calculate an opening time between 0 and 15,000 msec.
+const long minOpening = 200;                                    // Shorter opening times are skipped, so that a valve opens for at least 200 msec.
 
 
 //#######################################################################################
@@ -93,12 +151,25 @@ const int windowSize = 75;                                       // The PID will
 //#######################################################################################
 
 //# Switches and logical operators #
-boolean lowDO = false;                        // boolean for low oxygen threshold
-int activeChannel = 1;                        // measurement channel
-int check;                                    // numerical indicator of succesful measurement (1: success, 0: no connection, 9: mismatch)
+int sampleRound;                              // oversampling round of the current cycle
+bool channelDone[channelNumber];              // the value of the channel is final in this cycle
+bool channelShown[channelNumber];             // the progress mark of the finished channel is on the LCD
 
 //# Measurement timing #
-unsigned long loopStart, elapsed;             // ms timestamp of beginning and end of measurement loop
+unsigned long loopStart;                      // ms timestamp of the beginning of the measurement cycle
+ArdoxyInterval pace[channelNumber];           // measurement interval of each channel
+unsigned long measureStart;                   // µs timestamp when the FireSting started the cycle
+ArdoxyProfiler profiler;                      // duration of the stages below, lateness of the cycle starts, overruns
+const byte stageStart = 0;                    // stages of the loop: clock, regime, logfile and start of the cycle
+const byte stageMeasure = 1;                  // FireSting measurement of all channels and oversampling rounds
+const byte stageProcess = 2;                  // processChannel() (filter, alarm, PID)
+const byte stageSerial = 3;                   // readings on the serial monitor (text or telemetry)
+const byte stageLCD = 4;                      // readings on the LCD (I2C)
+const byte stageSD = 5;                       // logfile and capture
+const byte stageButtons = 6;                  // LCD buttons (I2C)
+const byte stageValves = 7;                   // closing the valves and alarm timers, every pass of the loop
+const char stageNames[] PROGMEM = "start   measure process serial  lcd     sd      buttons valves  ";
+bool measured[channelNumber];                 // the channel is measured in this cycle
 int curday, lastday;                          // int of current day and last day (date) - to detect change and create a new logfile every day
 
 //# Logging and SD card #
@@ -107,31 +178,33 @@ SdFs SD;
 FsFile logfile;                               // initializes the logfile
 char filename[21];                            // array for filename of .csv file
 byte n = 0;                                   // row index for .csv file
+#if BINARY_LOG
+bool writeLogBlock(unsigned long block, const byte data[]);
+ArdoxyLog binLog(writeLogBlock);              // collects binary records and writes them in 512-byte blocks
+#endif
+FsFile captureFile;                           // serial traffic of the FireSting (captureSerial), appended after each reset
+ArdoxyCapture capture(captureFile);
 
 //# Oxygen optode #
-char DOReadCom[11] = "REA 1 3 4\r";           // template for DO-read command that is sent to sensor during void toggleRead() (length = 10 because of /0 string terminator)
-char tempReadCom[11] = "REA 1 3 5\r";         // temperature read command
-long DOInt, tempInt;                          // for measurement result
-long DOSum;                                   // summing variable for air saturations in case oversampling is used (see sample variable)
+long tempInt;                                 // for measurement result
+ArdoxyFilter DOFilter[channelNumber];         // averages the oversampled air saturations, rejects failed measurements and spikes
 double DOFloat[channelNumber], tempFloat;     // measurement result as floating point number
-double lowDOValue;                            // variable for low DO values that are below the critical threshold defined above
-char lowDOTank[6];                            // array for tank name in which low DO has been measured
+bool DOValid[channelNumber];                  // false if the channel was skipped in this cycle (FireSting not reachable), DOFloat keeps the last value
+ArdoxyAlarm alarm;                            // low DO alarm of each channel
+ArdoxyTelemetry telemetry(Serial);            // binary frames with sequence number and timestamp
+int airValve[channelNumber];                  // valve index of the air valve of each channel (-1: none)
+unsigned long lastButtons;                    // ms timestamp of the last check of the LCD buttons
 Ardoxy ardoxy(Serial1);                       // create ardoxy instance on hardware serial port 1
+ArdoxyManager manager;                        // measures the channels in the background, processChannel() gets each result
 
 //# Relay operation #
-double relayArray[3][channelNumber];          // array with relay pin and assigned output values
-double Output[channelNumber];                 // holds output that was calculated by PID library
-
-//# Hardcoded PID setup for 4 control channels #
-PID relay1PID(&DOFloat[0], &Output[0], &airSatThreshold[0], Kp[0], Ki[0], Kd[0], REVERSE);    
-PID relay2PID(&DOFloat[1], &Output[1], &airSatThreshold[1], Kp[1], Ki[1], Kd[1], REVERSE);
-PID relay3PID(&DOFloat[2], &Output[2], &airSatThreshold[2], Kp[2], Ki[2], Kd[2], REVERSE);
-PID relay4PID(&DOFloat[3], &Output[3], &airSatThreshold[3], Kp[3], Ki[3], Kd[3], REVERSE);
+ArdoxyValves valves;                          // closes the solenoid valves when their opening time has passed
+ArdoxyControl<channelNumber> control;         // PID state of all channels, computes the valve opening times
+ArdoxySchedule regime(regimeTable, sizeof(regimeTable) / sizeof(regimeTable[0]));   // threshold of the scheduled channels
 
 //# LCD Display #
 Adafruit_RGBLCDShield lcd = Adafruit_RGBLCDShield();
 int airSatLCD = 0;                            // integer to display rounded values (due to space constraints on the LCD)
-int cursorX = 0;                              // X position of cursor
 
 
 //#######################################################################################
@@ -141,168 +214,327 @@ int cursorX = 0;                              // X position of cursor
 //###                           measurement channels.                                 ###
 //#######################################################################################
 
-//# Send air saturation readings to serial monitor and LCD #
+//# Send temperature, air saturation and valve opening time of each channel in one binary frame #
+void sendTelemetry() {
+  int values[1 + 2 * channelNumber];
+  values[0] = ArdoxyTelemetry::centi(tempInt);
+  for (int k = 0; k < channelNumber; k++) {
+    values[1 + k] = measured[k] && DOValid[k] ? ArdoxyTelemetry::centi(lround(DOFloat[k] * 1000)) : ARDOXY_TELEMETRY_NONE;
+    values[1 + channelNumber + k] = control.output(k);   // ms, at most maxOpening
+  }
+  telemetry.send(values, 1 + 2 * channelNumber);
+}
+
+//# Send air saturation readings to serial monitor (or as telemetry frame) and LCD #
 void showNewData() {
+  if (binaryTelemetry) {
+    ARDOXY_PROFILE_STAGE(profiler, stageSerial);
+    sendTelemetry();
+  } else {
+    ARDOXY_PROFILE_STAGE(profiler, stageSerial);
+    DateTime now;
+    now = RTC.now();  
+    Serial.print(now.year(), DEC);
+    Serial.print('/');
+    Serial.print(now.month(), DEC);
+    Serial.print('/');
+    Serial.print(now.day(), DEC);
+    Serial.print(F(" - "));
+    Serial.print(now.hour(), DEC);
+    Serial.print(':');
+    Serial.print(now.minute(), DEC);
+    Serial.print(':');
+    Serial.print(now.second(), DEC);
+    Serial.println();
+    Serial.print(tempID);
+    Serial.print(F(": "));
+    Serial.print(tempFloat);
+    Serial.println(F("°C "));
+    for (int k = 0; k < channelNumber; k++) {
+      Serial.print(tankID[k]);
+      if (!DOValid[k]) {
+        Serial.println(F(": com error"));
+        continue;
+      }
+      Serial.print(F(": "));
+      Serial.print(DOFloat[k]);
+      Serial.println(F("% air saturation"));
+    }
+  }
+
+  ARDOXY_PROFILE_STAGE(profiler, stageLCD);
   lcd.clear();
   lcd.setCursor(0, 0);
-  DateTime now;
-  now = RTC.now();  
-  Serial.print(now.year(), DEC);
-  Serial.print('/');
-  Serial.print(now.month(), DEC);
-  Serial.print('/');
-  Serial.print(now.day(), DEC);
-  Serial.print(" - ");
-  Serial.print(now.hour(), DEC);
-  Serial.print(':');
-  Serial.print(now.minute(), DEC);
-  Serial.print(':');
-  Serial.print(now.second(), DEC);
-  Serial.println();
-  Serial.print(tempID);
-  Serial.print(": ");
-  Serial.print(tempFloat);
-  Serial.println("°C ");
-
   for (int k = 0; k < (channelNumber); k++) {
     if (k == 4) {                                     
       lcd.setCursor(0, 1);                          // break line on LCD display when the 5th DO value is reached
     }
+    if (!DOValid[k]) {
+      lcd.print(F("-- "));
+      continue;
+    }
     airSatLCD = int(lround(DOFloat[k]));
     lcd.print(airSatLCD);
-    lcd.print(" ");
-    Serial.print(tankID[k]);
-    Serial.print(": ");
-    Serial.print(DOFloat[k]);
-    Serial.println("% air saturation");
+    lcd.print(alarm.latched(k) ? '!' : ' ');        // low DO alarm, active or not yet acknowledged
+  }
+}
+
+
+//# Remember the baud rate of the FireSting, so that begin() probes it first after a reset #
+void saveBaud(long baud, int ver) {
+  long storedBaud;
+  EEPROM.get(0, storedBaud);
+  if (storedBaud != baud) {                           // only write if changed to spare the EEPROM
+    EEPROM.put(0, baud);
   }
 }
 
 
-//# Check if air saturations are below the lowDO threshold #
-void DOCheck() {
-  for (int k = 0; k < channelNumber; k++){
-    if (DOFloat[k] < lowDOThreshold){
-      lowDO = true;
-      lowDOValue = DOFloat[k];
-      strcpy(lowDOTank, tankID[k]);
+//# Low DO alarm of a channel: N2 stays off (see finishChannel), air is bubbled if there's an air valve #
+void lowDOAlarm(byte k, long DO) {
+  Serial.print(F("low DO! Tank "));
+  Serial.print(tankID[k]);
+  Serial.print(F(", measured value: "));
+  Serial.println(DO / 1000.00);
+  valves.open(airValve[k], 2 * maxInterval);            // kept open with each measurement until the alarm clears
+  lcd.setBacklight(RED);
+}
+
+//# The alarm of a channel cleared: back to normal control #
+void lowDORecovered(byte k, long DO) {
+  Serial.print(F("DO recovered in tank "));
+  Serial.println(tankID[k]);
+  valves.close(airValve[k]);
+}
+
+//# Acknowledge the alarms with the SELECT button of the LCD shield #
+void checkButtons() {
+  if (millis() - lastButtons < 200) {
+    return;
+  }
+  lastButtons = millis();
+  ARDOXY_PROFILE_STAGE(profiler, stageButtons);
+  if (lcd.readButtons() & BUTTON_SELECT) {
+    alarm.acknowledgeAll();                             // alarms that are still active are released when they clear
+  }
+  bool latched = false;
+  for (int k = 0; k < channelNumber; k++) {
+    latched |= alarm.latched(k);
+  }
+  if (!latched) {
+    lcd.setBacklight(WHITE);
+  }
+}
+
+//# Commands on the serial monitor: "p" prints the cycle-time budget, "r" resets it #
+void checkSerial() {
+  if (!Serial.available()) {
+    return;
+  }
+  switch (Serial.read()) {
+    case 'p':
+      manager.printTiming(Serial);
+      profiler.print(Serial);
+      break;
+    case 'r':
+      manager.resetTiming();
+      profiler.reset();
+      break;
+  }
+}
+
+//# Final value of a channel: toggle its relay based on the measured airSat value (showProgress() displays it) #
+void finishChannel(int k) {
+  channelDone[k] = true;
+  manager.enableChannel(k, false);                      // skip the channel in the remaining oversampling rounds
+  DOValid[k] = DOFilter[k].count() > 0;
+  alarm.check(k, DOFilter[k].mean(), DOValid[k]);       // raises or clears the low DO alarm (lowDOAlarm(), lowDORecovered())
+  control.setInput(k, DOFilter[k].mean(), DOValid[k] && !alarm.active(k));  // invalid or alarm: the valve stays closed in this cycle
+  if (alarm.active(k)) {
+    valves.open(airValve[k], 2 * maxInterval);          // closes on its own if the channel is not measured anymore
+  }
+  if (DOValid[k]) {
+    DOFloat[k] = DOFilter[k].mean() / 1000.00;          // create floating point number for logging, display, etc.
+    pace[k].update(DOFilter[k].mean(), lround(airSatThreshold[k] * 1000), loopStart, control.output(k) >= minOpening);   // next interval of this channel
+  } else {                                              // FireSting not reachable, DOFloat keeps the last value
+    pace[k].skip(loopStart);
+  }
+  control.compute(k, pace[k].step(), pace[k].interval());   // compute the opening time based on the input (air saturation) and threshold
+  control.apply(valves, k, minOpening);                 // the valve opens now and closes on its own in valves.update()
+}
+
+//# Process one measurement while the FireSting measures the next channel (keep this short) #
+void processChannel(int k, const ArdoxyResult& res) {
+  ARDOXY_PROFILE_STAGE(profiler, stageProcess);
+  DOFilter[k].add(res);                                 // failed measurements and spikes are not averaged
+  if (res.check == 1) {                                 // every reading carries the temperature (measured or cached)
+    tempInt = res.temp;
+    tempFloat = tempInt / 1000.00;
+  }
+  if (DOFilter[k].converged() || sampleRound >= samples - 1) {   // precise enough or last round
+    finishChannel(k);
+  }
+}
+
+//# Mark the channels finished in the last round on the LCD: "." done, "x" com error #
+void showProgress() {                                   // not from processChannel(): I2C and serial output would delay the next reply
+  ARDOXY_PROFILE_STAGE(profiler, stageLCD);
+  for (int k = 0; k < channelNumber; k++) {
+    if (!channelDone[k] || channelShown[k]) {
+      continue;
+    }
+    channelShown[k] = true;
+    lcd.setCursor(k, 1);
+    if (DOValid[k]) {
+      lcd.print('.');
+    } else {
+      Serial.print(F("Com error on channel "));
+      Serial.println(channelArray[k]);
+      lcd.print('x');
     }
   }
 }
 
-//# Toggle relay based on measured airSat values #
-void toggleRelay() {
-  relay1PID.Compute();                                  // compute the output (output * 200 = opening time) based on the input (air saturation) and threshold
-  relay2PID.Compute();
-  relay3PID.Compute();
-  relay4PID.Compute();
-  
+//# Update the thresholds of the scheduled channels #
+void followRegime(DateTime now) {
+  long threshold = regime.setpoint(now.unixtime());     // only moves on when a breakpoint has passed
   for (int k = 0; k < channelNumber; k++) {
-    relayArray[0][k] = relayPin[k];
-    relayArray[1][k] = double(int(Output[k])*200.00);   // PID computes an output between 0 and 50, the multiplicator makes sure that the relay operation time is at least 200ms
-    relayArray[2][k] = DOFloat[k];
-  }
-  double temp[4];                                       // temporary array to sort all channels with the smallest based on the computed output (lowest output first). 
-                                                        // This is necessary as the valves are kept open using the delay()-function which halts all activity. 
-                                                        // With 8 channels, opening one valve after the other is too time consuming. With the opening times sorted, all valves 
-                                                        // can be opened at the same time and then closed one after another.
-  for (int k = 0; k < channelNumber - 1; k++) {         // sort array with lowest difference first
-    for (int m = k + 1; m < channelNumber; m++) {
-      if (relayArray[1][m] < relayArray[1][k]) {
-        temp[0] = relayArray[0][k];                     // store higer value + relayPin in temp array
-        temp[1] = relayArray[1][k];
-        temp[2] = relayArray[2][k];
-        relayArray[0][k] = relayArray[0][m];            // move lower value to position i
-        relayArray[1][k] = relayArray[1][m];
-        relayArray[2][k] = relayArray[2][m];
-        relayArray[0][m] = temp[0];                     // insert higher value at position j
-        relayArray[1][m] = temp[1];                     // now the values at i and j have switched places in the relayArray
-        relayArray[2][m] = temp[2];
-      }
+    if (scheduled[k]) {
+      airSatThreshold[k] = threshold / 1000.0;
+      control.setSetpoint(k, threshold);
     }
   }
+}
+
+//# Check if the interval of any channel has passed #
+bool measurementDue() {
   for (int k = 0; k < channelNumber; k++) {
-    if (relayArray[1][k] > 0){                              // skip the channels that don't have to be operated (output = 0.00)
-      for (int m = k; m < channelNumber; m++) {             // open all other valves
-        digitalWrite(relayArray[0][m], LOW);
-      }
-      if (k == 0) {                                         // close the valve with the lowest output first
-        delay(relayArray[1][k]);
-        digitalWrite(relayArray[0][k], HIGH);
-      }
-      else {
-        delay(relayArray[1][k] - relayArray[1][k - 1]);     // keep the other valves open based on the difference of the output value
-        digitalWrite(relayArray[0][k], HIGH);               // close the valve
-      }
+    if (pace[k].due(millis())) {
+      return true;
     }
   }
+  return false;
 }
 
+//# Start a measurement cycle of the channels whose interval has passed #
+void startMeasurement() {
+  lcd.clear();
+  lcd.setCursor(0, 0);
+  lcd.print(F("Measurement..."));
+  for (int k = 0; k < channelNumber; k++) {
+    measured[k] = pace[k].due(loopStart);
+    if (measured[k]) {
+      DOFilter[k].reset();                              // start a new series of measurements
+    }
+    channelDone[k] = !measured[k];
+    channelShown[k] = !measured[k];
+    manager.enableChannel(k, measured[k]);
+  }
+  sampleRound = 0;
+  manager.startCycle();                                 // the FireSting is recovered first if it did not answer in the last cycle
+}
+
+#if BINARY_LOG
+//# Write one block of the binary log to the logfile #
+bool writeLogBlock(unsigned long block, const byte data[]) {
+  if (!logfile.seekSet(block * ARDOXY_LOG_BLOCK) || logfile.write(data, ARDOXY_LOG_BLOCK) != ARDOXY_LOG_BLOCK) {
+    return false;
+  }
+  return logfile.flush();                           // update the file size once per block, not once per row
+}
+
+//# Create binary logfile on SD card, one day of records is allocated in one piece #
+void createBinaryLogfile(DateTime now){
+  logfile = SD.open(filename, FILE_WRITE);
+  if (logfile && binLog.begin(now.unixtime(), sampleInterval / 1000, channelNumber, tempID)) {
+    for (int i = 0; i < channelNumber; i++) {
+      binLog.setChannel(i, tankID[i], channelArray[i], lround(airSatThreshold[i] * 1000));
+    }
+    unsigned long blocks = 2 + 86400UL / ((adaptiveInterval ? minInterval : sampleInterval) / 1000) / ((ARDOXY_LOG_BLOCK - ARDOXY_LOG_BLOCK_HEADER) / binLog.recordSize());
+    logfile.preAllocate(blocks * ARDOXY_LOG_BLOCK);   // contiguous file: blocks are written without searching for free clusters
+    Serial.print(F("Logfile created: "));
+    Serial.println(filename);
+    lcd.setCursor(0,1);
+    lcd.print(filename);
+  }
+  else {
+    Serial.println(F("error: couldn't create logfile"));
+    lcd.setCursor(0, 1);
+    lcd.print(F(".bin failed"));
+    while (1);                                                // do nothing
+  }
+}
+#endif
+
 //# Create logfile on SD card (needs global variable "filename")
 void createLogfile(){
 
   DateTime now;
   now = RTC.now();                                  // fetch time and date from RTC
-  sprintf(filename, "%4d_%2d_%2d_%2d_%2d.csv", now.year(), now.month(), now.day(), now.hour(), now.minute()); // choose filename for logfile on SD that does not exist yet, includes a three-digit sequence number in the file name
+  sprintf(filename, "%4d_%2d_%2d_%2d_%2d.%s", now.year(), now.month(), now.day(), now.hour(), now.minute(), BINARY_LOG ? "bin" : "csv"); // choose filename for logfile on SD that does not exist yet, includes a three-digit sequence number in the file name
   Serial.println(filename);
   delay(100);
+#if BINARY_LOG
+  createBinaryLogfile(now);
+  return;
+#endif
       
 // Create logfile and write header information
   logfile = SD.open(filename, FILE_WRITE);                
   if (logfile) {
-    logfile.println(";");                                   // print a leading blank line
-    logfile.print("Date:;");                                // print header information: date, time, air saturation threshold, channels, tank IDs etc
+    logfile.println(F(";"));                                   // print a leading blank line
+    logfile.print(F("Date:;"));                                // print header information: date, time, air saturation threshold, channels, tank IDs etc
     logfile.print(now.year(), DEC);
-    logfile.print("/");
+    logfile.print(F("/"));
     logfile.print(now.month(), DEC);
-    logfile.print("/");
+    logfile.print(F("/"));
     logfile.print(now.day(), DEC);
-    logfile.print(";");
-    logfile.print("Time:;");
+    logfile.print(F(";"));
+    logfile.print(F("Time:;"));
     logfile.print(now.hour(), DEC);
-    logfile.print(":");
+    logfile.print(F(":"));
     logfile.print(now.minute(), DEC);
-    logfile.print(":");
+    logfile.print(F(":"));
     logfile.println(now.second(), DEC);
-    logfile.print(";Measurement interval [sec]:;");
+    logfile.print(F(";Measurement interval [sec]:;"));
     logfile.print(sampleInterval / 1000);
-    logfile.print(";Active channels:;");
+    logfile.print(F(";Active channels:;"));
     logfile.print(channelNumber);
-    logfile.print(";Temp Sensor:;");
+    logfile.print(F(";Temp Sensor:;"));
     logfile.print(tempID);
     logfile.println();
-    logfile.print("Tank ID:;");
+    logfile.print(F("Tank ID:;"));
     for (int i = 0; i < channelNumber; i++) {
       logfile.print(tankID[i]);
-      logfile.print(";");
+      logfile.print(F(";"));
     }
-    logfile.println(";");
-    logfile.print("Channel:;");
+    logfile.println(F(";"));
+    logfile.print(F("Channel:;"));
     for (int i = 0; i < (channelNumber); i++) {
       logfile.print(channelArray[i]);
-      logfile.print(";");
+      logfile.print(F(";"));
     }
-    logfile.println(";");
-    logfile.print("Air sat threshold [% air saturation]:;");
+    logfile.println(F(";"));
+    logfile.print(F("Air sat threshold [% air saturation]:;"));
     for (int i = 0; i < (channelNumber); i++) {
       logfile.print(airSatThreshold[i]);
-      logfile.print(";");
+      logfile.print(F(";"));
     }
-    logfile.println(";");
-    logfile.println(";");
-    logfile.print("Measurement;Date;Time;Temp_");                  // header row for measurements: Measurement, Date, Time, tankID1, tankID2,...
+    logfile.println(F(";"));
+    logfile.println(F(";"));
+    logfile.print(F("Measurement;Date;Time;Temp_"));                  // header row for measurements: Measurement, Date, Time, tankID1, tankID2,...
     logfile.print(tempID);
-    logfile.print(";");
+    logfile.print(F(";"));
     for (int i = 0; i < (channelNumber); i++) {
-      logfile.print("DO_");
+      logfile.print(F("DO_"));
       logfile.print(tankID[i]);
-      logfile.print(";");
+      logfile.print(F(";"));
     }
     logfile.println();
     logfile.flush();                                  // save data to logfile
 
     // Print to Serial monitor
-    Serial.print("Logfile created: ");
+    Serial.print(F("Logfile created: "));
     Serial.println(filename);
 
     // Print to LCD
@@ -310,22 +542,38 @@ void createLogfile(){
     lcd.print(filename);
   }
   else if (!logfile) {                                        // check if logfile was created
-    Serial.println("error: couldn't create logfile");
+    Serial.println(F("error: couldn't create logfile"));
     lcd.setCursor(0, 1);
-    lcd.print(".csv failed");
+    lcd.print(F(".csv failed"));
     while (1);                                                // do nothing
   }
 }
 
 //# Log dissolved oxygen measurements to SD card #
 void writeToSD() {
+#if BINARY_LOG
+  long DOLog[channelNumber];
+  unsigned int failed = 0;
+  for (int k = 0; k < channelNumber; k++) {
+    DOLog[k] = lround(DOFloat[k] * 1000);
+    if (!measured[k] || !DOValid[k]) {
+      failed |= 1 << k;                               // status bit: no new measurement (not due or skipped)
+    }
+  }
+  if (!binLog.add(RTC.now().unixtime(), tempInt, DOLog, failed)) {   // the record is buffered, a block is written every few records
+    Serial.println(F("error: can't write SD"));
+    lcd.clear();
+    lcd.print(F("SD write error"));
+  }
+  return;
+#endif
   if (!SD.exists(filename)) {
     lcd.clear();
     lcd.setCursor(0, 0);
-    lcd.print("error!");
+    lcd.print(F("error!"));
     lcd.setCursor(0, 1);
-    lcd.print("no SD");
-    Serial.println("error: can't read SD");
+    lcd.print(F("no SD"));
+    Serial.println(F("error: can't read SD"));
     while (1);
   }
   else {
@@ -333,24 +581,26 @@ void writeToSD() {
     now = RTC.now();                                  // fetch time and date from RTC
     n = n + 1;                                        // increase n by one for each measurement
     logfile.print(n);                                 // print row index n
-    logfile.print(";");                               // print a semicolon to separate values
+    logfile.print(F(";"));                               // print a semicolon to separate values
     logfile.print(now.year(), DEC);                   // print date and time of measurement
-    logfile.print("/");
+    logfile.print(F("/"));
     logfile.print(now.month(), DEC);
-    logfile.print("/");
+    logfile.print(F("/"));
     logfile.print(now.day(), DEC);
-    logfile.print(";");
+    logfile.print(F(";"));
     logfile.print(now.hour(), DEC);
-    logfile.print(":");
+    logfile.print(F(":"));
     logfile.print(now.minute(), DEC);
-    logfile.print(":");
+    logfile.print(F(":"));
     logfile.print(now.second(), DEC);
-    logfile.print(";");
+    logfile.print(F(";"));
     logfile.print(tempFloat);
-    logfile.print(";");
-    for (int k = 0; k < channelNumber; k++) {         // print air saturation measurements for each channel
-      logfile.print(DOFloat[k]);
-      logfile.print(";");
+    logfile.print(F(";"));
+    for (int k = 0; k < channelNumber; k++) {         // print air saturation measurements for each channel (empty if not due or skipped)
+      if (measured[k] && DOValid[k]) {
+        logfile.print(DOFloat[k]);
+      }
+      logfile.print(F(";"));
     }
     logfile.println();
     logfile.flush();                                  // save data to logfile
@@ -367,48 +617,70 @@ void writeToSD() {
 void setup() {
   Serial.begin(19200);
   delay(300);
-  Serial.println("-------------- Ardoxy 4 channel control example -------------");
-  ardoxy.begin();
+  Serial.println(F("-------------- Ardoxy 4 channel control example -------------"));
+  long storedBaud;
+  EEPROM.get(0, storedBaud);                      // baud rate of the last connection (ignored if invalid)
+  ardoxy.setConnectHook(saveBaud);
+  ardoxy.begin(storedBaud);
+  ardoxy.setCompensationAge(tempMaxAge);
+  int device = manager.addDevice(ardoxy);
+  for (int i = 0; i < channelNumber; i++) {
+    manager.addChannel(device, channelArray[i]);  // slot i of the manager is channel i of this sketch
+  }
+  manager.setResultHook(processChannel);
+  profiler.begin(adaptiveInterval ? minInterval : sampleInterval, stageNames);   // a longer cycle delays the next one
     
-//# Set up one PID per channel #
-  relay1PID.SetMode(AUTOMATIC);
-  relay1PID.SetSampleTime(sampleInterval);
-  relay1PID.SetOutputLimits(0, windowSize);
-  relay2PID.SetMode(AUTOMATIC);
-  relay2PID.SetSampleTime(sampleInterval);
-  relay2PID.SetOutputLimits(0, windowSize);
-  relay3PID.SetMode(AUTOMATIC);
-  relay3PID.SetSampleTime(sampleInterval);
-  relay3PID.SetOutputLimits(0, windowSize);
-  relay4PID.SetMode(AUTOMATIC);
-  relay4PID.SetSampleTime(sampleInterval);
-  relay4PID.SetOutputLimits(0, windowSize);
+//# Set up the PID of each channel #
+  regime.begin(ArdoxySchedule::toEpoch(regimeStart[0], regimeStart[1], regimeStart[2]));
+  for (int i = 0; i < channelNumber; i++) {
+    control.setSetpoint(i, lround(airSatThreshold[i] * 1000));
+    control.setTunings(i, Kp[i], Ki[i], Kd[i]);
+  }
+  control.setDirection(ARDOXY_REVERSE);           // N2 lowers the air saturation: open longer when it is above the threshold
+  control.setSampleTime(sampleInterval);           // the gains apply to this interval, opening times are scaled to the actual one
+  for (int i = 0; i < channelNumber; i++) {
+    pace[i].setLimits(adaptiveInterval ? minInterval : sampleInterval, adaptiveInterval ? maxInterval : sampleInterval, sampleInterval);   // not longer than sampleInterval while bubbling
+    pace[i].setThresholds(rateLimit, errorLimit);
+  }
+  control.setOutputLimits(0, maxOpening);
+  for (int i = 0; i < channelNumber; i++) {
+    DOFilter[i].setTarget(maxError);
+    DOFilter[i].setSpikeLimit(spikeLimit);
+  }
   
 //# Start LCD display, clear serial buffer #
   lcd.begin(16, 2);
   lcd.setBacklight(WHITE);
   lcd.clear();
   lcd.setCursor(0, 0);
-  lcd.print("DO ctrl booting.");
+  lcd.print(F("DO ctrl booting."));
   delay(100);
 
 //# Declare output pins for relay operation #
   lcd.clear();
-  lcd.print("Relay pins..");
-  for (int i = 0; i < channelNumber; i++) {       // declare relay pins as output pins and write HIGH to close magnetic valves
-    pinMode(relayPin[i], OUTPUT);
-    digitalWrite(relayPin[i], HIGH);
+  lcd.print(F("Relay pins.."));
+  control.begin(valves, relayPin, LOW);           // declare relay pins as output pins, valves open with LOW and are closed now
+  for (int i = 0; i < channelNumber; i++) {
+    airValve[i] = airPin[i] ? valves.addValve(airPin[i], LOW) : -1;
   }
+  alarm.begin(channelNumber);
+  for (int i = 0; i < channelNumber; i++) {
+    alarm.setThreshold(i, lround(lowDOThreshold * 1000), lround(lowDOHysteresis * 1000));
+  }
+  alarm.setRecovery(alarmRecovery);
+  alarm.setLatching(true);
+  alarm.onRaise(lowDOAlarm);
+  alarm.onClear(lowDORecovered);
   delay(100);
 
 //# Initialize the real time clock #
   lcd.clear();
-  lcd.print("Init RTC...");
+  lcd.print(F("Init RTC..."));
   Wire.begin();                                   // initialize real time clock
   if (!RTC.begin()) {                             // check if RTC is initialized
     lcd.setCursor(0, 1);
-    Serial.println("RTC failed");
-    lcd.print("RTC failed");
+    Serial.println(F("RTC failed"));
+    lcd.print(F("RTC failed"));
     while(1);
   }
   if(setRTC){
@@ -435,35 +707,43 @@ void setup() {
 
 //# Initialize SD card #
   lcd.clear();
-  lcd.print("Check SD...");
+  lcd.print(F("Check SD..."));
   if (!SD.begin(chipSelect)) {                    // check if SD card is present and can be read
-    Serial.println("Card failed, or not present. Please insert SD card and reboot the system.");
+    Serial.println(F("Card failed, or not present. Please insert SD card and reboot the system."));
     lcd.setCursor(0, 1);
-    lcd.print("SD failed");
+    lcd.print(F("SD failed"));
     while (1);
   }
   delay(500);
 
+  if (captureSerial) {
+    captureFile = SD.open("capture.bin", FILE_WRITE);
+    if (captureFile) {
+      ardoxy.setCapture(&capture);                // starts a new session in the file
+    }
+  }
+
 //# Create a new logfile #
+  followRegime(RTC.now());                        // the header lists today's thresholds
   lcd.clear();
-  lcd.print("Create .csv...");
+  lcd.print(F("Create .csv..."));
   createLogfile();
   delay(500);
 
 //# Display control settings 
-  Serial.print("Start of measurement cycles. Measurement interval set at ");
+  Serial.print(F("Start of measurement cycles. Measurement interval set at "));
   Serial.print(sampleInterval / 1000);
-  Serial.println(" seconds.");
-  Serial.println("-------------------------------------------------------------");
+  Serial.println(F(" seconds."));
+  Serial.println(F("-------------------------------------------------------------"));
   lcd.clear();
-  lcd.print("Ready");
+  lcd.print(F("Ready"));
   lcd.setCursor(0, 1);
-  lcd.print("Interval: ");
+  lcd.print(F("Interval: "));
   lcd.print(sampleInterval / 1000);
-  lcd.print("s");
+  lcd.print(F("s"));
   delay(2000);
   lcd.clear();
-  lcd.print("---Thresholds---");
+  lcd.print(F("---Thresholds---"));
   delay(1000);
   lcd.clear();
   for (int i = 0; i < channelNumber; i++){
@@ -478,7 +758,7 @@ void setup() {
       lcd.setCursor(0, 1);
     }
     lcd.print(airSatThreshold[i]);
-    lcd.print(" ");
+    lcd.print(F(" "));
   }
   delay(2000); 
   lcd.clear();
@@ -490,89 +770,77 @@ void setup() {
 //#######################################################################################
 //###                                 Main loop                                       ###
 //###               Congratulations, you made it to the main loop.                    ###
-//### I inserted delays between every subfunctions to ensure their completion before  ###
-//### the program moves to the next step. Some of these are crucial as the sensor     ###
-//### needs time to complete measurements. Also with serial communication, we want to ###
-//### make sure that everything has been completely sent and received.                ###
+//### The loop never waits for the FireSting: it starts a measurement cycle as soon   ###
+//### as the interval of a channel has passed, closes the valves when they are due    ###
+//### and finishes the cycle (logging and display) as soon as the last channel is    ###
+//### measured. The channels themselves (filter, low DO alarm, PID) are processed in  ###
+//### processChannel() while the next one is measured.                               ###
 //#######################################################################################
 
 void loop() {
-  loopStart = millis();                                       // start timer of loop
-  DateTime now;
-  now = RTC.now();  
-  curday = now.day();
-  if (curday != lastday){                                     // create a new logfile for every day
-    logfile.close();
-    delay(100);
-    createLogfile();
-    lastday = curday;
-  }
-  lcd.clear();
-  cursorX = 0;
-  lcd.setCursor(0, 0);
-  lcd.print("Measurement...");
-  for (int i = 0; i < channelNumber; i++) {                   // loop that iterates through every channel
-    DOSum = 0;                                                // reset summing variable for measurements
-    DOInt = 0;                                                // reset value variable
-    lcd.setCursor(cursorX, 1);
-    lcd.print(".");
-    cursorX += 1;
-    activeChannel = channelArray[i];                          // declare channel to be measured for serial commands
-    sprintf(DOReadCom, "REA %d 3 4\r", activeChannel);        // insert channel in readout command
-    for (int j = 0; j < samples; j++) {                       // oversampling loop 
-      check = 0;                                              // reset check variable
-      while(!check){                                          // as long as check doesn't come out positive, try to measure and reconnect
-        check = ardoxy.measureSeq(i+1);
-        if(!check){
-          Serial.println("Com error. Restarting serial communication.");
-          lcd.clear();
-          lcd.setCursor(0,0);
-          lcd.print("Com error!");
-          ardoxy.end();
-          delay(1000);
-          ardoxy.begin();
-          delay(2000);
-        }
-      }
-
-      DOInt = ardoxy.readout(DOReadCom);              // read out DO value
-      if (i == 0){                                    // with the first measurement, also read out temperature
-        tempInt = ardoxy.readout(tempReadCom);
-        tempFloat = tempInt / 1000.00;
+  unsigned long valvesStart = ARDOXY_PROFILE_MICROS();
+  valves.update();                                            // close valves when their opening time has passed
+  alarm.update();                                             // clear low DO alarms whose recovery time has passed
+  profiler.stage(stageValves, valvesStart);
+  checkButtons();
+  checkSerial();
+  if (!manager.busy() && measurementDue()) {
+    loopStart = millis();                                     // start timer of loop
+    unsigned long late = 0;
+    for (int k = 0; k < channelNumber; k++) {
+      if (pace[k].late(loopStart) > late) {
+        late = pace[k].late(loopStart);                       // the channel that has waited longest
       }
-      DOSum = DOSum + DOInt;                          // sum up air saturation readings for consecutive samples
     }
-    DOFloat[i] = DOSum / (samples * 1000.00);         // create floating point number for logging, display, etc. Results in 0 if there's a communication error
+    profiler.cycleStart(late);
+    unsigned long startStart = ARDOXY_PROFILE_MICROS();
+    DateTime now;
+    now = RTC.now();  
+    followRegime(now);
+    curday = now.day();
+    if (curday != lastday){                                   // create a new logfile for every day
+#if BINARY_LOG
+      binLog.sync();                                          // write the records that are still buffered
+#endif
+      logfile.close();
+      delay(100);
+      createLogfile();
+      lastday = curday;
+    }
+    startMeasurement();
+    profiler.stage(stageStart, startStart);
+    measureStart = ARDOXY_PROFILE_MICROS();
+  }
+  if (!manager.poll()) {                                      // measurement in progress or waiting for the next interval
+    return;
   }
+  sampleRound++;
+  showProgress();                                             // channels finished in this round
+  for (int k = 0; k < channelNumber && sampleRound < samples; k++) {
+    if (!channelDone[k]) {
+      manager.startCycle();                                   // next oversampling round of the channels that are not precise enough yet
+      return;
+    }
+  }
+  profiler.stage(stageMeasure, measureStart);
+  unsigned long finishStart = micros();
+  for (int k = 0; k < channelNumber; k++) {
+    if (!channelDone[k]) {                                    // due but not measured in the last round (FireSting not reachable)
+      finishChannel(k);
+    }
+  }
+  showProgress();                                             // com errors of the channels finished above
   showNewData();                                      // display measurement on LCD
-  delay(100);
+  unsigned long sdStart = ARDOXY_PROFILE_MICROS();
   writeToSD();                                        // log to SD card
-  delay(100);
-  DOCheck();                                          // check if low DO threshold is crossed
-  if (lowDO){
-    Serial.print("low DO! Measured value: ");         // halt program for 20 min to let DO value recover... more code can be inserted here to open an air valve or to light an alarm LED
-    Serial.println(lowDOValue);
-    lcd.clear();
-    lcd.print("low DO at ");
-    lcd.print(lowDOTank);
-    lcd.setCursor(0,1);
-    lcd.print("measured: ");
-    lcd.print(lowDOValue);
-    delay(1200*1000UL);
-    lowDO = false;
-  } else { 
-    toggleRelay();                                    // operate relays to open solenoid valves
-    elapsed = millis() - loopStart;                   // calculate duration of loop
-    if (elapsed > sampleInterval) {                   // adjust measurement interval if loop takes longer than measurement interval
-      sampleInterval = elapsed;
-      lcd.clear();
-      lcd.print("Short int.");
-      lcd.setCursor(0, 1);
-      lcd.print("New: ");
-      lcd.print(sampleInterval/1000);
-      lcd.print("sec");
-    } else {
-      delay(sampleInterval - elapsed);                // adjust delay so that loop duration equals measurement interval
-    }
+  if (captureSerial && captureFile) {
+    capture.flush();
+    captureFile.flush();                              // keep the capture of a rig that hangs or resets
+  }
+  profiler.stage(stageSD, sdStart);
+  manager.timeStage(ARDOXY_STAGE_FINISH, finishStart);
+  profiler.cycleEnd();
+  if (showTiming) {
+    manager.printTiming(Serial);
   }
 }
@@ -0,0 +1,88 @@
+/*
+  Ardoxy example - measure 12 channels on 3 FireSting devices at the same time
+
+  Every cycle, each FireSting measures its channels one after another (DO, temperature, air pressure),
+  while the three devices work in parallel. The ArdoxyManager collects the results as they arrive and
+  publishes one snapshot per cycle, which is printed to the serial monitor.
+  The loop never waits for a measurement, so other tasks (display, logging, valves) keep running.
+
+  The circuit:
+  - Arduino Mega
+  - 3 FireStingO2 - 7 pin connector:
+    *Pin 1 connected to Arduino GND
+    *Pin 2 connected to Arduino 5V
+    *Pin 4 connected to Arduino RX1 / RX2 / RX3 (19 / 17 / 15)
+    *Pin 5 connected to Arduino TX1 / TX2 / TX3 (18 / 16 / 14)
+
+  created 16 October 2026
+  based on the examples by Stefan Mucha
+
+*/
+
+#include <Ardoxy.h>
+#include <ArdoxyManager.h>
+
+// Set sampling interval in ms
+unsigned long sampInterval = 5000;
+
+// Define variables
+const int deviceNumber = 3;                   // number of FireSting devices
+const int channelsPerDevice = 4;              // channels per FireSting
+char tankID[deviceNumber * channelsPerDevice][4] = {"A1", "A2", "A3", "A4", "B1", "B2", "B3", "B4", "C1", "C2", "C3", "C4"};
+unsigned long lastCycle;                      // ms timestamp of the last cycle start
+
+// Create one Ardoxy instance per hardware serial port and the manager
+Ardoxy ardoxy1(Serial1);
+Ardoxy ardoxy2(Serial2);
+Ardoxy ardoxy3(Serial3);
+Ardoxy* ardoxys[deviceNumber] = {&ardoxy1, &ardoxy2, &ardoxy3};
+ArdoxyManager manager;
+
+void setup() {
+  Serial.begin(19200);
+  delay(300);
+  Serial.println(F("-------------- Ardoxy multi-device example -------------"));
+  for (int d = 0; d < deviceNumber; d++) {
+    ardoxys[d]->begin();
+    int device = manager.addDevice(*ardoxys[d]);
+    for (int c = 1; c <= channelsPerDevice; c++) {
+      manager.addChannel(device, c);              // snapshot order: device 1 channels 1-4, device 2 channels 1-4, ...
+    }
+  }
+  Serial.print(F("Measurement interval (ms): "));
+  Serial.println(sampInterval);
+  Serial.println(F("--------------------------------------------------------"));
+}
+
+void loop() {
+  // start a cycle on all devices when the interval has passed
+  if (!manager.busy() && millis() - lastCycle >= sampInterval) {
+    lastCycle = millis();
+    manager.startCycle();
+  }
+
+  // collect results as they arrive - returns true once the cycle is complete
+  if (manager.poll()) {
+    const ArdoxySnapshot& snap = manager.snapshot();
+    Serial.print(F("Cycle "));
+    Serial.print(snap.cycle);
+    Serial.print(F(" ("));
+    Serial.print(snap.completed - snap.started);
+    Serial.println(F(" ms)"));
+    for (int k = 0; k < snap.count; k++) {
+      Serial.print(tankID[k]);
+      Serial.print(F(": "));
+      if (snap.results[k].check == 1) {
+        Serial.print(snap.results[k].DO / 1000.00);
+        Serial.print(F("% air saturation, "));
+        Serial.print(snap.results[k].temp / 1000.00);
+        Serial.println(F("°C"));
+      } else {
+        Serial.print(F("com error "));
+        Serial.println(snap.results[k].check);
+      }
+    }
+  }
+
+  // ... other work here
+}
@@ -0,0 +1,96 @@
+/*
+  Ardoxy example - non-blocking measurement
+
+  Trigger a measurement sequence (DO, temperature, air pressure) without halting the Arduino
+  while the FireSting measures. The loop keeps running (here: blinking the built-in LED) and
+  polls the library until the reply has arrived. Then the DO value is read out the same way.
+  Oxygen probe is connected to channel 1.
+
+  The circuit:
+  - Arduino Uno
+  - FireStingO2 - 7 pin connector:
+    *Pin 1 connected to Arduino GND
+    *Pin 2 connected to Arduino 5V
+    *Pin 4 connected to Arduino RX (here: 10)
+    *Pin 5 connected to Arduino TX (here: 9)
+
+  created 16 October 2026
+  based on the examples by Stefan Mucha
+
+*/
+
+#include <Ardoxy.h>
+#include <SoftwareSerial.h>
+
+// Set sampling interval in ms
+unsigned long sampInterval = 2000;
+
+// Define variables
+char DOReadCom[11] = "REA 1 3 4\r";         // template for DO-read command that is sent to sensor
+unsigned long lastSample, lastBlink;        // ms timestamps of last measurement start and last LED toggle
+int step = 0;                               // 0: idle, 1: measuring, 2: reading out
+bool ledState = false;
+
+// Initiate connection via SoftwareSerial and create Ardoxy instance
+SoftwareSerial mySer(10, 9);
+Ardoxy ardoxy(mySer);
+
+// Keep receiving the reply while the sketch waits in delay() or other libraries call yield(), so the
+// 64-byte receive buffer of SoftwareSerial can't overflow (it fills in ~5 ms at 115200 baud)
+void yield() {
+  Ardoxy::serviceAll();
+}
+
+void setup() {
+  Serial.begin(19200);
+  delay(300);
+  Serial.println(F("------------- Ardoxy non-blocking measurement example -------------"));
+  ardoxy.begin();
+  pinMode(LED_BUILTIN, OUTPUT);
+}
+
+void loop() {
+  // other work keeps running while the FireSting measures
+  if (millis() - lastBlink >= 100) {
+    lastBlink = millis();
+    ledState = !ledState;
+    digitalWrite(LED_BUILTIN, ledState);
+  }
+
+  switch (step) {
+    case 0:                                   // start a new measurement when the interval has passed
+      if (millis() - lastSample >= sampInterval) {
+        lastSample = millis();
+        ardoxy.startMeasureSeq(1);
+        step = 1;
+      }
+      break;
+    case 1:                                   // wait for the echo of the measurement command
+      if (ardoxy.poll()) {
+        if (ardoxy.result() == 1) {
+          ardoxy.startReadout(DOReadCom);
+          step = 2;
+        } else {
+          Serial.print(F("Measurement status: "));
+          Serial.println(ardoxy.result());
+          step = 0;
+        }
+      }
+      break;
+    case 2:                                   // wait for the readout
+      if (ardoxy.poll()) {
+        if (ardoxy.result() == 1) {
+          Serial.print(F("Dissolved oxygen: "));
+          Serial.print(ardoxy.value() / 1000.00);
+          Serial.print(F(" ("));
+          Serial.print(millis() - lastSample);
+          Serial.println(F(" ms)"));
+        } else {
+          Serial.print(F("Readout status: "));
+          Serial.println(ardoxy.result());
+        }
+        step = 0;
+      }
+      break;
+  }
+}
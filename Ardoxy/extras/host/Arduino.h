@@ -0,0 +1,101 @@
+/*
+  Arduino.h - Minimal Arduino core for building Ardoxy on a Linux host.
+  Time is simulated: millis() / micros() read a virtual clock that is advanced by delay(),
+  yield() and a small cost per clock query, so busy-wait loops terminate and the modelled
+  wall-time of a command can be measured. See HostArduino.cpp.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define LED_BUILTIN 13
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) hostReadWord(p)
+#define pgm_read_dword(p) hostReadDword(p)
+#define strcpy_P(d, s) strcpy((d), (s))
+#define strncmp_P(a, b, n) strncmp((a), (b), (n))
+
+// pgm_read_word / pgm_read_dword: 2 and 4 bytes as on AVR, copied to keep strict aliasing
+static inline uint16_t hostReadWord(const void* p) {uint16_t v; memcpy(&v, p, sizeof(v)); return v;}
+static inline uint32_t hostReadDword(const void* p) {uint32_t v; memcpy(&v, p, sizeof(v)); return v;}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+// Virtual clock control for host programs
+unsigned long long hostMicros();
+void hostAdvance(unsigned long long us);
+extern void (*hostYieldHook)();                 // called by yield() and once per ms of delay(), like yield() on AVR
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t len) {size_t n = 0; while (len--) n += write(*buf++); return n;}
+    size_t write(const char* str) {return str ? write((const uint8_t*)str, strlen(str)) : 0;}
+    size_t write(const char* buf, size_t len) {return write((const uint8_t*)buf, len);}
+    size_t print(const char* s) {return write(s);}
+    size_t print(char c) {return write((uint8_t)c);}
+    size_t print(int v, int base=DEC) {return print((long)v, base);}
+    size_t print(unsigned int v, int base=DEC) {return print((unsigned long)v, base);}
+    size_t print(long v, int base=DEC) {char b[24]; snprintf(b, sizeof(b), base == HEX ? "%lX" : "%ld", v); return write(b);}
+    size_t print(unsigned long v, int base=DEC) {char b[24]; snprintf(b, sizeof(b), base == HEX ? "%lX" : "%lu", v); return write(b);}
+    size_t print(double v, int digits=2) {char b[40]; snprintf(b, sizeof(b), "%.*f", digits, v); return write(b);}
+    size_t println() {return write("\r\n");}
+    template<class T> size_t println(T v) {size_t n = print(v); return n + println();}
+    template<class T> size_t println(T v, int f) {size_t n = print(v, f); return n + println();}
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+};
+
+// Default HardwareSerial prints to stdout and never receives anything
+class HardwareSerial : public Stream
+{
+  public:
+    virtual void begin(unsigned long baud) {(void)baud;}
+    virtual void end() {}
+    virtual int available() {return 0;}
+    virtual int read() {return -1;}
+    virtual int peek() {return -1;}
+    virtual size_t write(uint8_t c) {if (!quiet) putchar(c); return 1;}
+    using Print::write;
+    bool quiet = false;
+};
+
+extern HardwareSerial Serial;
+
+#endif
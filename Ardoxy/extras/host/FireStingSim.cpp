@@ -0,0 +1,197 @@
+/*
+  FireStingSim.cpp - Scripted FireSting simulator, see FireStingSim.h.
+*/
+
+#include "FireStingSim.h"
+
+FireStingSim::FireStingSim(const FireStingConfig& cfg)
+{
+  config = cfg;
+  rng = cfg.seed ? cfg.seed : 1;
+  baseTemp = 21345;
+  for (int c = 0; c < SIM_CHANNELS; c++) {
+    baseAirSat[c] = 95000 - 20000L * c;
+    for (int r = 0; r < SIM_REGISTERS; r++) {
+      regs[c][r] = 0;
+    }
+    measure(c + 1, 3);
+  }
+}
+
+void FireStingSim::begin(unsigned long baud)
+{
+  hostBaud = baud;
+  rx.clear();
+  received.clear();
+  line.clear();
+}
+
+void FireStingSim::end()
+{
+  hostBaud = 0;
+  rx.clear();
+  received.clear();
+  line.clear();
+}
+
+// Time for one byte (start bit, 8 data bits, stop bit) at the device baud rate
+unsigned long long FireStingSim::byteTime() const
+{
+  return 10000000ULL / config.baud;
+}
+
+double FireStingSim::uniform()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  rng &= 0xFFFFFFFFUL;
+  return (rng % 1000000UL) / 1000000.0;
+}
+
+int FireStingSim::available()
+{
+  unsigned long long now = hostMicros();
+  while (!rx.empty() && rx.front().first <= now) {
+    if (config.rxBuffer && received.size() >= config.rxBuffer) {
+      overflows++;
+    } else {
+      received.push_back(rx.front().second);
+    }
+    rx.pop_front();
+  }
+  return received.size();
+}
+
+int FireStingSim::read()
+{
+  if (!available()) return -1;
+  char c = received.front();
+  received.pop_front();
+  bytesFromDevice++;
+  return (uint8_t)c;
+}
+
+int FireStingSim::peek()
+{
+  return available() ? (uint8_t)received.front() : -1;
+}
+
+size_t FireStingSim::write(uint8_t c)
+{
+  if (!hostBaud) return 0;
+  bytesToDevice++;
+  unsigned long long now = hostMicros();
+  txClock = (txClock > now ? txClock : now) + byteTime();
+  if (hostBaud != config.baud) {
+    return 1;                                 // device only sees framing errors
+  }
+  if (c == '\r') {
+    handle(line, txClock);
+    line.clear();
+  } else if (line.size() < 64) {
+    line += (char)c;
+  }
+  return 1;
+}
+
+void FireStingSim::setReading(int chan, long airSat, long temp)
+{
+  if (chan < 1 || chan > SIM_CHANNELS) return;
+  baseAirSat[chan - 1] = airSat;
+  baseTemp = temp;
+  measure(chan, 3);
+}
+
+long FireStingSim::reg(int chan, int index) const
+{
+  if (chan < 1 || chan > SIM_CHANNELS || index < 0 || index >= SIM_REGISTERS) return 0;
+  return regs[chan - 1][index];
+}
+
+// Update the results register of a channel: bit 0 oxygen, bit 1 temperature
+void FireStingSim::measure(int chan, int what)
+{
+  long* r = regs[chan - 1];
+  if (what & 1) {
+    r[4] = baseAirSat[chan - 1] + (long)(uniform() * 400) - 200;     // % air saturation x 1000
+    r[1] = 20000 + r[4] / 5;                                          // dphi
+    r[2] = r[4] * 27 / 10;                                            // µmol/L x 1000
+    r[3] = r[4] * 21 / 100;                                           // mbar x 1000
+    r[7] = 120000;                                                    // signal intensity
+    r[8] = 3000;                                                      // ambient light
+  }
+  if (what & 2) {
+    r[5] = baseTemp + (long)(uniform() * 40) - 20;                    // °C x 1000
+    r[6] = baseTemp + 1500;                                           // case temperature
+    r[9] = 1013250;                                                   // mbar x 1000
+    r[10] = 45000;                                                    // humidity
+  }
+  r[0] = 0;                                                           // status: no warnings
+}
+
+void FireStingSim::handle(const std::string& cmd, unsigned long long at)
+{
+  commands++;
+  if (config.silentRate > 0 && uniform() < config.silentRate) return;
+
+  char op[8] = "";
+  int a[4] = {0, 0, 0, 0};
+  int n = sscanf(cmd.c_str(), "%7s %d %d %d %d", op, &a[0], &a[1], &a[2], &a[3]) - 1;
+  std::string out = cmd;
+  char buf[16];
+  bool chanOk = a[0] >= 1 && a[0] <= SIM_CHANNELS;
+
+  if (!strcmp(op, "#VERS")) {
+    snprintf(buf, sizeof(buf), " 1 4 %d 15 0", config.version);
+    reply(out + buf, at, config.versLatency);
+  } else if ((!strcmp(op, "MSR") || !strcmp(op, "TMP") || !strcmp(op, "SEQ")) && n == 1 && chanOk) {
+    int what = op[0] == 'M' ? 1 : op[0] == 'T' ? 2 : 3;
+    measure(a[0], what);
+    reply(out, at, what == 1 ? config.msrLatency : what == 2 ? config.tmpLatency : config.seqLatency);
+  } else if (!strcmp(op, "MEA") && n == 2 && chanOk && config.version >= 400) {
+    int what = a[1] & 3;
+    measure(a[0], what);
+    for (int r = 0; r < SIM_REGISTERS; r++) {
+      snprintf(buf, sizeof(buf), " %ld", regs[a[0] - 1][r]);
+      out += buf;
+    }
+    reply(out, at, what == 1 ? config.msrLatency : what == 2 ? config.tmpLatency : config.seqLatency);
+  } else if (!strcmp(op, "REA") && n == 3 && chanOk) {
+    long v = (a[1] == 3 && a[2] >= 0 && a[2] < SIM_REGISTERS) ? regs[a[0] - 1][a[2]] : 0;
+    snprintf(buf, sizeof(buf), " %ld", v);
+    reply(out + buf, at, config.readLatency);
+  } else if (!strcmp(op, "RMR") && n == 4 && chanOk && a[3] > 0 && a[3] <= SIM_REGISTERS) {
+    for (int i = 0; i < a[3]; i++) {
+      int r = a[2] + i;
+      snprintf(buf, sizeof(buf), " %ld", (a[1] == 3 && r >= 0 && r < SIM_REGISTERS) ? regs[a[0] - 1][r] : 0L);
+      out += buf;
+    }
+    reply(out, at, config.readLatency);
+  } else {
+    reply("#ERRO -21", at, config.readLatency);
+  }
+}
+
+// Queue a reply: it starts after the latency (and after any reply still being sent)
+void FireStingSim::reply(const std::string& text, unsigned long long at, unsigned long latency)
+{
+  std::string s = text + "\r";
+  long jitterUs = 0;
+  if (config.jitter) {
+    jitterUs = (long)((uniform() * 2 - 1) * config.jitter * 1000);
+  }
+  long long start = (long long)at + (long long)latency * 1000 + jitterUs;
+  if (start < (long long)at) start = at;
+  if ((unsigned long long)start < busyUntil) start = busyUntil;
+  if (config.garbleRate > 0 && uniform() < config.garbleRate) {
+    s[(size_t)(uniform() * (s.size() - 1))] = '?';
+  }
+  unsigned long long t = start;
+  for (size_t i = 0; i < s.size(); i++) {
+    t += byteTime();
+    if (config.dropRate > 0 && uniform() < config.dropRate) continue;
+    rx.push_back(std::make_pair(t, s[i]));
+  }
+  busyUntil = t;
+}
@@ -0,0 +1,79 @@
+/*
+  FireStingSim.h - Scripted FireSting simulator for host builds of Ardoxy.
+  Behaves like the serial port a FireSting is connected to: commands written to it are answered
+  after a configurable measurement latency, and reply bytes become available at the modelled
+  baud rate on the virtual clock of the host Arduino core.
+  Understands #VERS, MSR, TMP, SEQ, MEA (firmware >= 400), REA and RMR.
+  Faults: latency jitter, dropped reply bytes, garbled echoes, ignored commands and baud mismatch.
+  With a limited receive buffer, bytes that arrive while it is full are lost (receive overflow).
+*/
+
+#ifndef FireStingSim_h
+#define FireStingSim_h
+
+#include "Arduino.h"
+#include <deque>
+#include <string>
+#include <utility>
+
+#define SIM_CHANNELS 4
+#define SIM_REGISTERS 17
+
+struct FireStingConfig
+{
+  int version = 403;                          // firmware version reported by #VERS
+  unsigned long baud = 19200;                 // baud rate of the device
+  unsigned long versLatency = 20;             // ms until the reply of #VERS starts
+  unsigned long msrLatency = 90;              // ms for a DO measurement (MSR, MEA C 1)
+  unsigned long tmpLatency = 150;             // ms for a temperature measurement (TMP, MEA C 2)
+  unsigned long seqLatency = 280;             // ms for a full sequence (SEQ, MEA C 3)
+  unsigned long readLatency = 2;              // ms until the reply of REA / RMR starts
+  unsigned long jitter = 0;                   // +/- ms added to every latency (uniform)
+  double dropRate = 0;                        // probability that a reply byte is lost
+  double garbleRate = 0;                      // probability that the echo of a reply is corrupted
+  double silentRate = 0;                      // probability that a command is ignored
+  unsigned long seed = 1;                     // seed of the fault and noise generator
+  unsigned int rxBuffer = 0;                  // receive buffer of the port in bytes (0: unlimited, Arduino serial ports: 64)
+};
+
+class FireStingSim : public HardwareSerial
+{
+  public:
+    FireStingSim(const FireStingConfig& cfg = FireStingConfig());
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+
+    void setReading(int chan, long airSat, long temp);
+    long reg(int chan, int index) const;
+
+    FireStingConfig config;
+    unsigned long commands = 0;               // commands received
+    unsigned long bytesToDevice = 0;          // bytes written by the library
+    unsigned long bytesFromDevice = 0;        // bytes delivered to the library
+    unsigned long overflows = 0;              // reply bytes lost because the receive buffer was full
+
+  private:
+    void handle(const std::string& cmd, unsigned long long at);
+    void reply(const std::string& text, unsigned long long at, unsigned long latency);
+    void measure(int chan, int what);
+    unsigned long long byteTime() const;
+    double uniform();
+
+    std::deque<std::pair<unsigned long long, char> > rx;   // reply bytes and their arrival time (µs)
+    std::deque<char> received;                // bytes that have arrived and wait in the receive buffer
+    std::string line;                         // command being received
+    unsigned long hostBaud = 0;               // baud rate the library opened the port with
+    unsigned long long txClock = 0;           // arrival time of the last byte sent to the device
+    unsigned long long busyUntil = 0;         // the device answers one command at a time
+    unsigned long rng;
+    long regs[SIM_CHANNELS][SIM_REGISTERS];
+    long baseAirSat[SIM_CHANNELS];
+    long baseTemp;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+  HostArduino.cpp - Virtual clock and pin stubs behind the host Arduino.h.
+  Every clock query costs a few microseconds of modelled CPU time, yield() a little more,
+  so polling loops advance time the way they would on an AVR.
+*/
+
+#include "Arduino.h"
+
+#define HOST_CLOCK_COST_US 4                  // modelled cost of one millis() / micros() call
+#define HOST_YIELD_COST_US 50                 // modelled cost of one yield() call
+
+static unsigned long long nowUs = 0;
+static uint8_t pinState[128];
+
+HardwareSerial Serial;
+void (*hostYieldHook)() = 0;
+
+unsigned long long hostMicros()
+{
+  return nowUs;
+}
+
+void hostAdvance(unsigned long long us)
+{
+  nowUs += us;
+}
+
+unsigned long millis()
+{
+  nowUs += HOST_CLOCK_COST_US;
+  return (unsigned long)(nowUs / 1000);
+}
+
+unsigned long micros()
+{
+  nowUs += HOST_CLOCK_COST_US;
+  return (unsigned long)nowUs;
+}
+
+void delay(unsigned long ms)
+{
+  for (unsigned long i = 0; i < ms; i++) {
+    nowUs += 1000;
+    if (hostYieldHook) hostYieldHook();
+  }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  nowUs += us;
+}
+
+void yield()
+{
+  nowUs += HOST_YIELD_COST_US;
+  if (hostYieldHook) hostYieldHook();
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin < sizeof(pinState)) pinState[pin] = val;
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < sizeof(pinState) ? pinState[pin] : LOW;
+}
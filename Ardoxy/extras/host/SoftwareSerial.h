@@ -0,0 +1,25 @@
+/*
+  SoftwareSerial.h - Host stand-in for the AVR SoftwareSerial library.
+  Never receives anything; use FireStingSim (a HardwareSerial) to talk to a simulated device.
+*/
+
+#ifndef SoftwareSerial_h
+#define SoftwareSerial_h
+
+#include "Arduino.h"
+
+class SoftwareSerial : public Stream
+{
+  public:
+    SoftwareSerial(uint8_t rx, uint8_t tx) {(void)rx; (void)tx;}
+    void begin(long baud) {(void)baud;}
+    void end() {}
+    bool listen() {return true;}
+    int available() {return 0;}
+    int read() {return -1;}
+    int peek() {return -1;}
+    size_t write(uint8_t c) {(void)c; return 1;}
+    using Print::write;
+};
+
+#endif
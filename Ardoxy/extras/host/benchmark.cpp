@@ -0,0 +1,479 @@
+/*
+  benchmark.cpp - Modelled wall-time per reading for the Ardoxy methods, against FireStingSim.
+
+  Build (from this directory):
+    g++ -std=c++11 -Wall -Wextra -O2 -I. -I../.. benchmark.cpp FireStingSim.cpp HostArduino.cpp ../../Ardoxy*.cpp -o ardoxy_bench
+
+  Usage:
+    ./ardoxy_bench [-n runs] [-v firmware] [-b baud] [-j jitter_ms] [-d drop_rate] [-g garble_rate] [-x silent_rate] [-s seed] [-S] [-C capture]
+
+  Every method runs n times on a fresh connection. Reported are the share of successful calls,
+  the modelled time per call (mean / min / max in ms) and the serial bytes per call.
+  The last section compares one acquisition cycle over 3 devices x 4 channels: channel by channel
+  with measureRead() against ArdoxyManager, which measures on all devices at the same time, and against
+  ArdoxyManager with setCompensationAge(60000). The previous cycle has just measured temperature and pressure,
+  so all channels take DO-only measurements; once the cache expires, the first channel of each device
+  measures the full sequence again (~190 ms longer).
+  The outage section runs the 4-channel example loop (30 s interval) while the FireSting stops answering
+  for 90 s: retrying with end() / delay() / begin() until it answers again, against recover() and
+  skipping the channel, and against ArdoxyManager, which recovers the device within its non-blocking poll().
+  Reported are the longest cycle, the number of cycles that overran the interval and the longest single
+  call into the library, i.e. the longest time the loop could not serve anything else.
+  The oversampling section averages up to 10 measureRead() results per reading: summed as in the examples
+  (failed readings count as 0), with ArdoxyFilter, and with ArdoxyFilter stopping at a standard error of 0.05 %.
+  The pipeline section models one cycle of the 4-channel example with 20 ms of processing per channel (filter,
+  PID, LCD) and 60 ms of logging and display per cycle: measure and process in turn with the former delays,
+  against the ArdoxyManager result hook, which processes a channel while the next one is measured.
+  With -C, the serial traffic of the methods is recorded with ArdoxyCapture (one session per method) for replay.cpp.
+  With -S, the stage timing of the pipelined cycle is printed as well.
+  The busy loop section runs measureRead() at 115200 baud into a 64-byte receive buffer while the sketch blocks
+  in delay() for 5, 20 or 50 ms between two poll() calls: polling only, against Ardoxy::serviceAll() called
+  from yield() (as the AVR core does during delay()). Reported are the complete readings, the readings whose
+  values are correct, and the reply bytes lost to a full buffer per reading.
+  The interval section models 6 h of one control tank at 100 % and one tank controlled with N2 (setpoint
+  100 -> 30 % after 1 h, 60 % after 4 h; re-aeration time constant 30 min, N2 lowers DO by 20 %/min): 30 s
+  fixed against ArdoxyInterval (10 - 120 s, 30 s while bubbling). Reported are the measurements, the time
+  to get within 2 % of the first step and the error once settled (from 30 min after each step).
+*/
+
+#include "Arduino.h"
+#include "FireStingSim.h"
+#include <Ardoxy.h>
+#include <ArdoxyManager.h>
+#include <ArdoxyFilter.h>
+#include <ArdoxyControl.h>
+#include <ArdoxyInterval.h>
+#include <ArdoxyCapture.h>
+#include <math.h>
+#include <unistd.h>
+
+// Print to a file, for ArdoxyCapture
+struct FilePrint : public Print
+{
+  FILE* f = 0;
+  size_t write(uint8_t c) {return fputc(c, f) != EOF;}
+  using Print::write;
+};
+
+struct Bench
+{
+  const char* name;
+  bool (*run)(Ardoxy& ardoxy);
+};
+
+static char DOReadCom[11] = "REA 1 3 4\r";
+static char tempReadCom[11] = "REA 1 3 5\r";
+
+static bool runGetVer(Ardoxy& a) {return a.getVer() >= 100;}
+static bool runMeasureSeq(Ardoxy& a) {return a.measureSeq(1) == 1;}
+static bool runMeasureDO(Ardoxy& a) {return a.measureDO(1) == 1;}
+static bool runMeasureTemp(Ardoxy& a) {return a.measureTemp() == 1;}
+static bool runReadout(Ardoxy& a) {return a.readout(DOReadCom) != 0;}
+static bool runReadoutDO(Ardoxy& a) {return a.readoutDO(1) != 0;}
+static bool runReadoutTemp(Ardoxy& a) {return a.readoutTemp() != 0;}
+static bool runSeqReadout(Ardoxy& a)
+{
+  // measurement cycle of the examples: sequence, then DO and temperature readout
+  return a.measureSeq(1) == 1 && a.readout(DOReadCom) != 0 && a.readout(tempReadCom) != 0;
+}
+static bool runMeasureRead(Ardoxy& a)
+{
+  ArdoxyResult res;
+  return a.measureRead(1, res) == 1 && res.DO != 0;
+}
+static bool runReadoutRegs(Ardoxy& a)
+{
+  long values[2];
+  return a.readoutRegs(1, ARDOXY_REG_AIRSAT, 2, values) == 1;
+}
+
+// Outage model: the FireSting ignores all commands between the two timestamps (µs)
+struct Outage
+{
+  FireStingSim* sim;
+  unsigned long long from, until;
+  void update() {sim->config.silentRate = hostMicros() >= from && hostMicros() < until ? 1 : 0;}
+};
+
+// Channel loop of the 4-channel example before recover(): retry until the FireSting answers
+static bool retryForever(Ardoxy& a, Outage& o, int chan)
+{
+  ArdoxyResult res;
+  o.update();
+  while (!a.measureRead(chan, res)) {
+    a.end();
+    delay(1000);
+    o.update();
+    a.begin();
+    delay(2000);
+    o.update();
+  }
+  return res.check == 1;
+}
+
+// Channel loop with recover(): one resync and retry, then skip the channel
+static bool recoverOrSkip(Ardoxy& a, Outage& o, int chan)
+{
+  ArdoxyResult res;
+  o.update();
+  if (!a.online() && !a.recover()) return false;
+  if (a.measureRead(chan, res) == 1) return true;
+  o.update();
+  return a.recover() && a.measureRead(chan, res) == 1;
+}
+
+// Processing of one channel in the 4-channel example, modelled as busy time
+static void processChannel(int, const ArdoxyResult&)
+{
+  delay(20);
+}
+
+static const Bench benches[] = {
+  {"getVer", runGetVer},
+  {"measureSeq", runMeasureSeq},
+  {"measureDO", runMeasureDO},
+  {"measureTemp", runMeasureTemp},
+  {"readout", runReadout},
+  {"readoutDO", runReadoutDO},
+  {"readoutTemp", runReadoutTemp},
+  {"measureSeq+2x readout", runSeqReadout},
+  {"measureRead", runMeasureRead},
+  {"readoutRegs (DO, temp)", runReadoutRegs},
+};
+
+int main(int argc, char** argv)
+{
+  FireStingConfig cfg;
+  int runs = 100;
+  bool showStats = false;
+  FilePrint captureFile;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:v:b:j:d:g:x:s:SC:")) != -1) {
+    switch (opt) {
+      case 'n': runs = atoi(optarg); break;
+      case 'v': cfg.version = atoi(optarg); break;
+      case 'b': cfg.baud = strtoul(optarg, 0, 10); break;
+      case 'j': cfg.jitter = strtoul(optarg, 0, 10); break;
+      case 'd': cfg.dropRate = atof(optarg); break;
+      case 'g': cfg.garbleRate = atof(optarg); break;
+      case 'x': cfg.silentRate = atof(optarg); break;
+      case 's': cfg.seed = strtoul(optarg, 0, 10); break;
+      case 'S': showStats = true; break;
+      case 'C':
+        captureFile.f = fopen(optarg, "wb");
+        if (!captureFile.f) {
+          perror(optarg);
+          return 1;
+        }
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n runs] [-v firmware] [-b baud] [-j jitter_ms] [-d drop] [-g garble] [-x silent] [-s seed] [-S] [-C capture]\n", argv[0]);
+        return 1;
+    }
+  }
+  ArdoxyCapture capture(captureFile);
+  if (runs < 1) runs = 1;
+  Serial.quiet = true;
+
+  printf("firmware %d, %lu baud, jitter %lu ms, drop %.3f, garble %.3f, silent %.3f, %d runs\n",
+         cfg.version, cfg.baud, cfg.jitter, cfg.dropRate, cfg.garbleRate, cfg.silentRate, runs);
+
+  // connection setup
+  {
+    FireStingSim sim(cfg);
+    Ardoxy ardoxy(sim);
+    unsigned long long t0 = hostMicros();
+    ardoxy.begin();
+    printf("%-24s %9.1f ms\n", "begin", (hostMicros() - t0) / 1000.0);
+    ardoxy.end();
+    t0 = hostMicros();
+    ardoxy.begin();
+    printf("%-24s %9.1f ms\n\n", "begin (reconnect)", (hostMicros() - t0) / 1000.0);
+  }
+
+  printf("%-24s %7s %9s %9s %9s %9s\n", "method", "ok [%]", "mean [ms]", "min [ms]", "max [ms]", "bytes");
+  for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+    FireStingSim sim(cfg);
+    Ardoxy ardoxy(sim);
+    if (captureFile.f) ardoxy.setCapture(&capture);
+    ardoxy.begin();
+    sim.bytesToDevice = 0;
+    sim.bytesFromDevice = 0;
+    int ok = 0;
+    double sum = 0, lo = 1e12, hi = 0;
+    for (int i = 0; i < runs; i++) {
+      unsigned long long t0 = hostMicros();
+      if (benches[b].run(ardoxy)) ok++;
+      double ms = (hostMicros() - t0) / 1000.0;
+      sum += ms;
+      if (ms < lo) lo = ms;
+      if (ms > hi) hi = ms;
+      delay(50);                                // idle time between readings lets late replies settle
+    }
+    printf("%-24s %7.1f %9.1f %9.1f %9.1f %9.1f\n", benches[b].name, 100.0 * ok / runs, sum / runs, lo, hi,
+           (double)(sim.bytesToDevice + sim.bytesFromDevice) / runs);
+    ardoxy.setCapture(0);
+    if (showStats) {
+      Serial.quiet = false;
+      ardoxy.printStats(Serial);                // statistics as reported by the library itself
+      Serial.quiet = true;
+      printf("\n");
+    }
+  }
+
+  // acquisition cycle over several devices
+  {
+    FireStingSim sims[3] = {FireStingSim(cfg), FireStingSim(cfg), FireStingSim(cfg)};
+    Ardoxy a0(sims[0]), a1(sims[1]), a2(sims[2]);
+    Ardoxy* ardoxys[3] = {&a0, &a1, &a2};
+    ArdoxyManager manager;
+    for (int d = 0; d < 3; d++) {
+      ardoxys[d]->begin();
+      int dev = manager.addDevice(*ardoxys[d]);
+      for (int c = 1; c <= 4; c++) manager.addChannel(dev, c);
+    }
+    double seq = 0, par = 0, cached = 0;
+    int seqOk = 0, parOk = 0, cachedOk = 0;
+    for (int i = 0; i < runs; i++) {
+      unsigned long long t0 = hostMicros();
+      ArdoxyResult res;
+      for (int d = 0; d < 3; d++) {
+        for (int c = 1; c <= 4; c++) seqOk += ardoxys[d]->measureRead(c, res) == 1;
+      }
+      seq += (hostMicros() - t0) / 1000.0;
+      delay(50);
+      t0 = hostMicros();
+      manager.startCycle();
+      while (!manager.poll()) yield();
+      par += (hostMicros() - t0) / 1000.0;
+      for (int k = 0; k < manager.snapshot().count; k++) parOk += manager.snapshot().results[k].check == 1;
+      delay(50);
+      for (int d = 0; d < 3; d++) ardoxys[d]->setCompensationAge(60000);
+      t0 = hostMicros();
+      manager.startCycle();
+      while (!manager.poll()) yield();
+      cached += (hostMicros() - t0) / 1000.0;
+      for (int k = 0; k < manager.snapshot().count; k++) cachedOk += manager.snapshot().results[k].check == 1;
+      for (int d = 0; d < 3; d++) ardoxys[d]->setCompensationAge(0);
+      delay(50);
+    }
+    printf("\n%-24s %7s %9s\n", "cycle 3 devices x 4 ch", "ok [%]", "mean [ms]");
+    printf("%-24s %7.1f %9.1f\n", "measureRead, in turn", 100.0 * seqOk / (12 * runs), seq / runs);
+    printf("%-24s %7.1f %9.1f\n", "ArdoxyManager", 100.0 * parOk / (12 * runs), par / runs);
+    printf("%-24s %7.1f %9.1f\n", "ArdoxyManager, temp 60 s", 100.0 * cachedOk / (12 * runs), cached / runs);
+  }
+
+  // pipelined cycle: 4 channels, 20 ms processing per channel, 60 ms logging and display per cycle
+  {
+    FireStingSim sim(cfg);
+    Ardoxy ardoxy(sim);
+    ardoxy.begin();
+    ArdoxyManager manager;
+    int dev = manager.addDevice(ardoxy);
+    for (int c = 1; c <= 4; c++) manager.addChannel(dev, c);
+    manager.setResultHook(processChannel);
+    double seq = 0, pipe = 0;
+    for (int i = 0; i < runs; i++) {
+      unsigned long long t0 = hostMicros();
+      ArdoxyResult res;
+      for (int c = 1; c <= 4; c++) {
+        ardoxy.measureRead(c, res);
+        processChannel(c - 1, res);
+      }
+      delay(100);                               // former delays between display, logging and check
+      delay(60);
+      delay(100);
+      seq += (hostMicros() - t0) / 1000.0;
+      delay(50);
+      t0 = hostMicros();
+      manager.startCycle();
+      while (!manager.poll()) yield();
+      unsigned long finishStart = micros();
+      delay(60);
+      manager.timeStage(ARDOXY_STAGE_FINISH, finishStart);
+      pipe += (hostMicros() - t0) / 1000.0;
+      delay(50);
+    }
+    printf("\n%-24s %9s\n", "cycle 4 ch + processing", "mean [ms]");
+    printf("%-24s %9.1f\n", "in turn, with delays", seq / runs);
+    printf("%-24s %9.1f\n", "result hook", pipe / runs);
+    if (showStats) {
+      Serial.quiet = false;
+      manager.printTiming(Serial);
+      Serial.quiet = true;
+    }
+  }
+
+  // busy sketch: 115200 baud into a 64-byte receive buffer, the loop blocks for a while between two poll() calls
+  {
+    FireStingConfig fast = cfg;
+    fast.baud = 115200;
+    fast.rxBuffer = 64;
+    const int work[3] = {5, 20, 50};
+    printf("\n%-24s %7s %9s %9s\n", "busy loop, 64 B buffer", "ok [%]", "exact [%]", "lost [B]");
+    for (int hook = 0; hook < 2; hook++) {
+      for (int w = 0; w < 3; w++) {
+        FireStingSim sim(fast);
+        Ardoxy ardoxy(sim);
+        ardoxy.begin();
+        hostYieldHook = hook ? Ardoxy::serviceAll : 0;
+        int ok = 0, exact = 0;
+        for (int i = 0; i < runs; i++) {
+          ardoxy.startMeasureRead(1);
+          while (!ardoxy.poll()) delay(work[w]);   // e.g. an SD write or LCD update between two polls
+          const ArdoxyResult& res = ardoxy.reading();
+          ok += res.check == 1;
+          exact += res.check == 1 && res.DO == sim.reg(1, ARDOXY_REG_AIRSAT) && res.temp == sim.reg(1, ARDOXY_REG_TEMP);
+          delay(50);
+        }
+        hostYieldHook = 0;
+        char name[32];
+        snprintf(name, sizeof(name), "%s, %d ms", hook ? "serviceAll()" : "poll() only", work[w]);
+        printf("%-24s %7.1f %9.1f %9.1f\n", name, 100.0 * ok / runs, 100.0 * exact / runs, (double)sim.overflows / runs);
+      }
+    }
+  }
+
+  // adaptive interval: plant model, no serial traffic
+  {
+    const char* names[2] = {"fixed 30 s", "ArdoxyInterval"};
+    printf("\n%-24s %9s %9s %9s %9s %9s\n", "interval, 6 h", "ctrl meas", "hyp meas", "settle [s]", "rms [%]", "max [%]");
+    for (int k = 0; k < 2; k++) {
+      long meas[2] = {0, 0};
+      long settle = -1, n = 0;
+      double sq = 0, worst = 0;
+      for (int tank = 0; tank < 2; tank++) {
+        ArdoxyValves valves;
+        ArdoxyControl<1> control;
+        byte pin[1] = {2};
+        control.begin(valves, pin);
+        control.setTunings(0, 2000, 200, 200);
+        control.setSampleTime(30000);
+        control.setOutputLimits(0, 15000);
+        ArdoxyInterval pace;
+        if (k == 0) pace.setLimits(30000, 30000);
+        else pace.setLimits(10000, 120000, 30000);
+        pace.setThresholds(1000, 5000);
+        double DO = 100000;
+        long sp = 100000;
+        unsigned long openUntil = 0;
+        for (unsigned long t = 0; t < 6 * 3600000UL; t += 100) {
+          if (tank == 1 && t == 3600000UL) sp = 30000;
+          if (tank == 1 && t == 4 * 3600000UL) sp = 60000;
+          DO += ((100000 - DO) / (30 * 60000.0) - (t < openUntil ? 20000 / 60000.0 : 0)) * 100;
+          if (pace.due(t)) {
+            meas[tank]++;
+            long m = lround(DO);
+            pace.update(m, sp, t, control.output(0) >= 200);
+            control.setSetpoint(0, sp);
+            control.setInput(0, m);
+            control.compute(0, pace.step(), pace.interval());
+            if (control.output(0) >= 200) openUntil = t + control.output(0);
+          }
+          if (tank == 1) {
+            if (t > 3600000UL && settle < 0 && fabs(DO - sp) < 2000) settle = (t - 3600000UL) / 1000;
+            if ((t >= 5400000UL && t < 4 * 3600000UL) || t >= 4 * 3600000UL + 1800000UL) {
+              double err = (DO - sp) / 1000;
+              sq += err * err;
+              n++;
+              if (fabs(err) > worst) worst = fabs(err);
+            }
+          }
+        }
+      }
+      printf("%-24s %9ld %9ld %9ld %9.2f %9.2f\n", names[k], meas[0], meas[1], settle, sqrt(sq / n), worst);
+    }
+  }
+
+  // oversampling: 10 measurements per reading, true value 95 % air saturation
+  {
+    const char* names[3] = {"sum of 10", "ArdoxyFilter, 10", "ArdoxyFilter, SE 0.05 %"};
+    printf("\n%-24s %7s %9s %9s %9s\n", "oversampling", "samples", "mean [ms]", "rms [%]", "max [%]");
+    for (int k = 0; k < 3; k++) {
+      FireStingSim sim(cfg);
+      sim.setReading(1, 95000, 21000);
+      Ardoxy ardoxy(sim);
+      ardoxy.begin();
+      ArdoxyFilter filter;
+      filter.setSpikeLimit(5000);
+      if (k == 2) filter.setTarget(50);
+      double sq = 0, worst = 0, time = 0;
+      long used = 0;
+      for (int i = 0; i < runs; i++) {
+        unsigned long long t0 = hostMicros();
+        ArdoxyResult res;
+        long sum = 0, value;
+        filter.reset();
+        int j = 0;
+        while (j < 10) {
+          ardoxy.measureRead(1, res);
+          j++;
+          if (k == 0) {
+            sum += res.DO;
+          } else {
+            filter.add(res);
+            if (filter.converged()) break;
+          }
+        }
+        value = k == 0 ? sum / 10 : filter.mean();
+        used += j;
+        time += (hostMicros() - t0) / 1000.0;
+        double err = (value - 95000) / 1000.0;
+        sq += err * err;
+        if (fabs(err) > worst) worst = fabs(err);
+      }
+      printf("%-24s %7.1f %9.1f %9.3f %9.3f\n", names[k], (double)used / runs, time / runs, sqrt(sq / runs), worst);
+    }
+  }
+
+  // 90 s outage during 20 cycles of 30 s, 4 channels
+  {
+    const char* names[3] = {"end/begin until answer", "recover() and skip", "ArdoxyManager"};
+    bool (*strategies[2])(Ardoxy&, Outage&, int) = {retryForever, recoverOrSkip};
+    printf("\n%-24s %7s %9s %9s %9s\n", "90 s outage, 20 cycles", "ok [%]", "max [ms]", "overruns", "call [ms]");
+    for (int k = 0; k < 3; k++) {
+      FireStingSim sim(cfg);
+      Ardoxy ardoxy(sim);
+      ardoxy.begin();
+      ArdoxyManager manager;
+      int dev = manager.addDevice(ardoxy);
+      for (int c = 1; c <= 4; c++) manager.addChannel(dev, c);
+      Outage outage = {&sim, hostMicros() + 95000000ULL, hostMicros() + 185000000ULL};
+      int ok = 0, overruns = 0;
+      double longest = 0, longestCall = 0;
+      for (int cycle = 0; cycle < 20; cycle++) {
+        unsigned long long t0 = hostMicros();
+        if (k < 2) {
+          for (int c = 1; c <= 4; c++) {
+            unsigned long long c0 = hostMicros();
+            ok += strategies[k](ardoxy, outage, c);
+            double call = (hostMicros() - c0) / 1000.0;
+            if (call > longestCall) longestCall = call;
+          }
+        } else {
+          outage.update();
+          manager.startCycle();
+          double call = (hostMicros() - t0) / 1000.0;
+          if (call > longestCall) longestCall = call;
+          for (;;) {
+            delay(1);                           // the loop serves other tasks between two polls
+            outage.update();
+            unsigned long long c0 = hostMicros();
+            bool done = manager.poll();
+            call = (hostMicros() - c0) / 1000.0;
+            if (call > longestCall) longestCall = call;
+            if (done) break;
+          }
+          for (int c = 0; c < 4; c++) ok += manager.snapshot().results[c].check == 1;
+        }
+        double ms = (hostMicros() - t0) / 1000.0;
+        if (ms > longest) longest = ms;
+        if (ms > 30000) overruns++;
+        else delay(30000 - (unsigned long)ms);
+      }
+      printf("%-24s %7.1f %9.1f %9d %9.1f\n", names[k], 100.0 * ok / 80, longest, overruns, longestCall);
+    }
+  }
+  if (captureFile.f) fclose(captureFile.f);
+  return 0;
+}
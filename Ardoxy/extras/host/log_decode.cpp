@@ -0,0 +1,160 @@
+/*
+  log_decode.cpp - Converts a binary log written with ArdoxyLog to CSV.
+
+  Build and run (from this directory):
+    g++ -std=c++11 -Wall -Wextra -O2 log_decode.cpp -o ardoxy_log_decode
+    ./ardoxy_log_decode LOG.BIN > log.csv
+
+  The output has the layout of the logfile of the measure_control_4chan example (header with date, interval,
+  tank IDs, channels and thresholds, then one row per record). Dates are printed as stored by the RTC.
+  Channels whose status bit is set (not measured or failed) get an empty cell, like in the CSV logfile.
+  Decoding stops at the first block that does not belong to the file (file id or block number differ),
+  so unused space of a pre-allocated file is skipped. The number of records whose status bits mark a
+  failed measurement is reported on stderr.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#define BLOCK 512
+#define BLOCK_HEADER 8
+#define ID_LEN 6
+
+static unsigned int get16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static unsigned long get32(const unsigned char* p)
+{
+  return get16(p) | ((unsigned long)get16(p + 2) << 16);
+}
+
+// Value x 100 with two decimals, like Print::print(double)
+static void printCenti(int v)
+{
+  if (v < 0) {
+    putchar('-');
+    v = -v;
+  }
+  printf("%d.%02d", v / 100, v % 100);
+}
+
+static void printID(const unsigned char* p)
+{
+  char id[ID_LEN + 1] = {};
+  memcpy(id, p, ID_LEN);
+  fputs(id, stdout);
+}
+
+static void printDate(unsigned long epoch)
+{
+  time_t t = epoch;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  printf("%d/%d/%d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+static void printTime(unsigned long epoch)
+{
+  time_t t = epoch;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  printf("%d:%d:%d", tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s LOG.BIN > log.csv\n", argv[0]);
+    return 2;
+  }
+  FILE* f = fopen(argv[1], "rb");
+  if (!f) {
+    fprintf(stderr, "can't open %s\n", argv[1]);
+    return 2;
+  }
+  unsigned char buf[BLOCK];
+  if (fread(buf, 1, BLOCK, f) != BLOCK || memcmp(buf, "ARDOXYL1", 8)) {
+    fprintf(stderr, "%s is not an Ardoxy log\n", argv[1]);
+    return 1;
+  }
+  unsigned long id = get32(buf + 8);
+  unsigned int interval = get16(buf + 12);
+  int channels = buf[14];
+  int recSize = buf[15];
+  if (channels > 16 || recSize != 8 + 2 * channels) {
+    fprintf(stderr, "%s: invalid header\n", argv[1]);
+    return 1;
+  }
+  const unsigned char* chan = buf + 22;
+
+  printf(";\r\n");
+  printf("Date:;");
+  printDate(id);
+  printf(";Time:;");
+  printTime(id);
+  printf("\r\n;Measurement interval [sec]:;%u;Active channels:;%d;Temp Sensor:;", interval, channels);
+  printID(buf + 16);
+  printf("\r\nTank ID:;");
+  for (int k = 0; k < channels; k++) {
+    printID(chan + 9 * k);
+    putchar(';');
+  }
+  printf(";\r\nChannel:;");
+  for (int k = 0; k < channels; k++) {
+    printf("%d;", chan[9 * k + 6]);
+  }
+  printf(";\r\nAir sat threshold [%% air saturation]:;");
+  for (int k = 0; k < channels; k++) {
+    printCenti((short)get16(chan + 9 * k + 7));
+    putchar(';');
+  }
+  printf(";\r\n;\r\nMeasurement;Date;Time;Temp_");
+  printID(buf + 16);
+  putchar(';');
+  for (int k = 0; k < channels; k++) {
+    printf("DO_");
+    printID(chan + 9 * k);
+    putchar(';');
+  }
+  printf("\r\n");
+
+  unsigned long n = 0, failed = 0;
+  int perBlock = (BLOCK - BLOCK_HEADER) / recSize;
+  for (unsigned int block = 1; fread(buf, 1, BLOCK, f) == BLOCK; block++) {
+    int count = get16(buf + 6);
+    if (get32(buf) != id || get16(buf + 4) != (block & 0xFFFF) || count == 0 || count > perBlock) {
+      break;
+    }
+    for (int r = 0; r < count; r++) {
+      const unsigned char* rec = buf + BLOCK_HEADER + r * recSize;
+      unsigned long epoch = get32(rec);
+      printf("%lu;", ++n);
+      printDate(epoch);
+      putchar(';');
+      printTime(epoch);
+      putchar(';');
+      printCenti((short)get16(rec + 4));
+      putchar(';');
+      unsigned int status = get16(rec + 6);
+      for (int k = 0; k < channels; k++) {
+        if (!(status & (1u << k))) {                                        // empty cell if not measured or failed
+          printCenti((short)get16(rec + 8 + 2 * k));
+        }
+        putchar(';');
+      }
+      printf("\r\n");
+      if (status & ((1u << channels) - 1)) {
+        failed++;
+      }
+    }
+    if (count < perBlock) {
+      break;                                                                // last, partially filled block
+    }
+  }
+  fclose(f);
+  fprintf(stderr, "%lu records, %lu with failed measurements\n", n, failed);
+  return 0;
+}
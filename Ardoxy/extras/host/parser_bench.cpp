@@ -0,0 +1,105 @@
+/*
+  parser_bench.cpp - CPU cost of reply parsing and command formatting: the previous buffer + libc path
+  (sprintf, strncmp, strtok, strrchr, atol) against the single-pass ArdoxyParser.
+
+  Build (from this directory):
+    g++ -std=c++11 -Wall -Wextra -O2 -flto -I. -I../.. parser_bench.cpp HostArduino.cpp ../../ArdoxyParser.cpp -o ardoxy_parser_bench
+
+  Times are host CPU times and only meaningful relative to each other. glibc's string functions are
+  vectorized on x86, so short single-value replies can favour the libc path here; avr-libc works byte
+  by byte, so on an Uno the extra passes over the buffer cost proportionally more. -flto matches the
+  Arduino build, which inlines the parser into the caller.
+*/
+
+#include "Arduino.h"
+#include <ArdoxyParser.h>
+#include <chrono>
+
+#define RUNS 1000000L
+#define BUF_CHARS 128                         // the library buffer had 60 characters, too few for a MEA reply
+
+struct Frame
+{
+  const char* name;
+  const char* command;
+  const char* reply;
+  int nValues;
+};
+
+static const Frame frames[] = {
+  {"REA (1 value)", "REA 1 3 4\r", "REA 1 3 4 95123", 1},
+  {"RMR (3 values)", "RMR 1 3 4 3\r", "RMR 1 3 4 3 95123 21345 22845", 3},
+  {"#VERS", "#VERS\r", "#VERS 1 4 403 15 0", 5},
+  {"MEA (10 values)", "MEA 1 3\r", "MEA 1 3 0 39024 256793 19976 95123 21345 22845 120000 3000 1013250", 10},
+};
+
+static volatile long sink;
+
+// Previous approach: copy the reply into a buffer, compare the echo with strncmp, then tokenize
+static long legacyParse(const Frame& f, long* values)
+{
+  char receivedChars[BUF_CHARS];
+  int ndx = 0;
+  for (const char* p = f.reply; *p && ndx < BUF_CHARS - 1; p++) {
+    receivedChars[ndx++] = *p;
+  }
+  receivedChars[ndx] = '\0';
+  if (strncmp(f.command, receivedChars, strlen(f.command) - 1) != 0) return -1;
+  if (f.nValues == 1) {
+    values[0] = atol(strrchr(receivedChars, ' '));
+    return 1;
+  }
+  char* tok = strtok(receivedChars + strlen(f.command) - 1, " ");
+  int n = 0;
+  while (tok && n < f.nValues) {
+    values[n++] = atol(tok);
+    tok = strtok(NULL, " ");
+  }
+  return n;
+}
+
+static long singlePass(const Frame& f, long* values)
+{
+  ArdoxyParser parser;
+  parser.begin(f.command, values, f.nValues);
+  for (const char* p = f.reply; *p; p++) {
+    parser.feed(*p);
+  }
+  parser.finish();
+  return parser.valid() ? parser.count() : -1;
+}
+
+template<class F> static double nsPerCall(F fn)
+{
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < RUNS; i++) {
+    fn();
+  }
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / RUNS;
+}
+
+int main()
+{
+  long values[16];
+  printf("%-18s %12s %12s %8s\n", "reply", "libc [ns]", "1-pass [ns]", "speedup");
+  for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+    const Frame& f = frames[i];
+    long a = legacyParse(f, values);
+    long b = singlePass(f, values);
+    if (a != b) {
+      printf("%s: results differ (%ld / %ld)\n", f.name, a, b);
+      return 1;
+    }
+    double legacy = nsPerCall([&]() {sink = legacyParse(f, values) + values[0];});
+    double single = nsPerCall([&]() {sink = singlePass(f, values) + values[0];});
+    printf("%-18s %12.1f %12.1f %7.2fx\n", f.name, legacy, single, legacy / single);
+  }
+
+  char buf[16];
+  int args[4] = {2, 3, 4, 3};
+  double legacy = nsPerCall([&]() {sprintf(buf, "RMR %d 3 %d %d\r", args[0], args[2], args[3]); sink = buf[4];});
+  double single = nsPerCall([&]() {ArdoxyParser::format(buf, sizeof(buf), "RMR", args, 4); sink = buf[4];});
+  printf("%-18s %12.1f %12.1f %7.2fx\n", "format RMR", legacy, single, legacy / single);
+  return 0;
+}
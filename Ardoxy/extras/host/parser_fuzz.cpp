@@ -0,0 +1,230 @@
+/*
+  parser_fuzz.cpp - Robustness check of ArdoxyParser against truncated, garbled and oversized replies.
+
+  Build and run (from this directory):
+    g++ -std=c++11 -Wall -Wextra -O1 -g -fsanitize=address,undefined -I. -I../.. parser_fuzz.cpp HostArduino.cpp ../../ArdoxyParser.cpp -o ardoxy_parser_fuzz
+    ./ardoxy_parser_fuzz corpus/mea_ok.txt corpus/msr_ok.txt ... [-i iterations] [-s seed]   (all files of corpus/)
+
+  Each corpus file holds the command that was sent (first line, without '\r') and the reply as received
+  (rest of the file, without the end marker). Every corpus entry is parsed as is and then mutated
+  (truncated, bytes flipped, inserted, deleted, duplicated) for the given number of iterations.
+  Checked for every input:
+  - no write outside the destination array (guard values around it)
+  - a reply accepted as valid matches a strict reference parser, value by value
+  ArdoxyParser::format() is checked as well, with large and negative arguments (INT_MIN, INT_MAX and random
+  ints) and every buffer size: no write past the buffer, and the command matches snprintf() whenever it fits.
+  With -DARDOXY_LIBFUZZER, the file builds as a libFuzzer target instead (input: command '\n' reply).
+*/
+
+#include "Arduino.h"
+#include <ArdoxyParser.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+
+#define DEST_SIZE 10
+#define GUARD 0x5A5A5A5AL
+
+static unsigned long failures = 0;
+
+// Strict reference: reply = echo, then values separated by spaces, each -?[0-9]{1,9}
+static bool referenceParse(const std::string& command, const std::string& reply, std::vector<long>& values)
+{
+  values.clear();
+  std::string echo = command.substr(0, command.find('\r'));
+  if (reply.compare(0, echo.size(), echo) != 0 || reply.size() < echo.size()) return false;
+  std::string rest = reply.substr(echo.size());
+  if (rest.empty()) return true;
+  if (rest[0] != ' ') return false;
+  size_t i = 0;
+  while (i < rest.size()) {
+    if (rest[i] == ' ') {i++; continue;}
+    size_t j = i;
+    bool neg = rest[j] == '-';
+    if (neg) j++;
+    size_t digitsStart = j;
+    long v = 0;
+    while (j < rest.size() && rest[j] >= '0' && rest[j] <= '9') {
+      if (j - digitsStart < ARDOXY_MAX_DIGITS) v = v * 10 + (rest[j] - '0');
+      j++;
+    }
+    size_t nd = j - digitsStart;
+    if (nd == 0 || nd > ARDOXY_MAX_DIGITS) return false;
+    if (j < rest.size() && rest[j] != ' ') return false;
+    values.push_back(neg ? -v : v);
+    i = j;
+  }
+  return true;
+}
+
+static void check(const std::string& command, const std::string& reply, const char* origin)
+{
+  long buf[DEST_SIZE + 2];
+  buf[0] = GUARD;
+  buf[DEST_SIZE + 1] = GUARD;
+  ArdoxyParser parser;
+  std::string cmd = command + "\r";
+  parser.begin(cmd.c_str(), buf + 1, DEST_SIZE);
+  for (size_t i = 0; i < reply.size(); i++) {
+    parser.feed(reply[i]);
+  }
+  parser.finish();
+
+  if (buf[0] != GUARD || buf[DEST_SIZE + 1] != GUARD) {
+    printf("FAIL %s: write outside destination\n", origin);
+    failures++;
+    return;
+  }
+  std::vector<long> ref;
+  bool refValid = referenceParse(command, reply, ref);
+  if (parser.valid() != refValid) {
+    printf("FAIL %s: valid %d, reference %d for \"%s\"\n", origin, parser.valid(), refValid, reply.c_str());
+    failures++;
+    return;
+  }
+  if (!refValid) return;
+  if (parser.count() != (ref.size() > 255 ? 255 : ref.size())) {
+    printf("FAIL %s: %d values, reference %d\n", origin, parser.count(), (int)ref.size());
+    failures++;
+    return;
+  }
+  for (size_t i = 0; i < ref.size() && i < DEST_SIZE; i++) {
+    if (buf[1 + i] != ref[i]) {
+      printf("FAIL %s: value %d is %ld, reference %ld\n", origin, (int)i, buf[1 + i], ref[i]);
+      failures++;
+      return;
+    }
+  }
+  if (!ref.empty() && parser.last() != ref.back()) {
+    printf("FAIL %s: last value %ld, reference %ld\n", origin, parser.last(), ref.back());
+    failures++;
+  }
+}
+
+static void checkFormat(const int args[], byte nArgs, const char* origin)
+{
+  char ref[200];
+  int refLen = snprintf(ref, sizeof(ref), "RMR");
+  for (byte i = 0; i < nArgs; i++) {
+    refLen += snprintf(ref + refLen, sizeof(ref) - refLen, " %d", args[i]);
+  }
+  refLen += snprintf(ref + refLen, sizeof(ref) - refLen, "\r");
+
+  for (int size = 0; size <= refLen + 2; size++) {
+    char buf[sizeof(ref) + 4];
+    memset(buf, 0x5A, sizeof(buf));
+    byte n = ArdoxyParser::format(buf, size, "RMR", args, nArgs);
+    for (size_t k = size; k < sizeof(buf); k++) {
+      if (buf[k] != 0x5A) {
+        printf("FAIL %s: format wrote past a buffer of %d bytes\n", origin, size);
+        failures++;
+        return;
+      }
+    }
+    if (size > refLen && (n != refLen || strcmp(buf, ref))) {
+      printf("FAIL %s: format gave \"%s\" (%d), reference \"%s\"\n", origin, n ? buf : "", n, ref);
+      failures++;
+      return;
+    }
+    if (size <= refLen && n) {
+      printf("FAIL %s: format returned %d for a buffer of %d bytes\n", origin, n, size);
+      failures++;
+      return;
+    }
+  }
+}
+
+#ifdef ARDOXY_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  std::string in((const char*)data, size);
+  size_t nl = in.find('\n');
+  if (nl == std::string::npos || nl > 32) return 0;
+  check(in.substr(0, nl), in.substr(nl + 1), "libfuzzer");
+  if (failures) abort();
+  return 0;
+}
+
+#else
+
+static unsigned long rng = 1;
+
+static unsigned long nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  rng &= 0xFFFFFFFFUL;
+  return rng;
+}
+
+static std::string mutate(std::string s)
+{
+  static const char alphabet[] = "0123456789 -\r\n?MEAR#";
+  int edits = 1 + nextRandom() % 4;
+  for (int e = 0; e < edits; e++) {
+    size_t pos = s.empty() ? 0 : nextRandom() % s.size();
+    switch (nextRandom() % 6) {
+      case 0: s = s.substr(0, pos); break;                                          // truncate
+      case 1: if (!s.empty()) s[pos] = (char)(nextRandom() & 0xFF); break;          // random byte
+      case 2: s.insert(pos, 1, alphabet[nextRandom() % (sizeof(alphabet) - 1)]); break;
+      case 3: if (!s.empty()) s.erase(pos, 1); break;
+      case 4: s.insert(pos, s.substr(pos, nextRandom() % 12)); break;               // duplicate a chunk
+      case 5: s.append(nextRandom() % 300, '9'); break;                             // oversized number
+    }
+  }
+  return s;
+}
+
+int main(int argc, char** argv)
+{
+  long iterations = 20000;
+  std::vector<std::pair<std::string, std::string> > corpus;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-i") && i + 1 < argc) {iterations = atol(argv[++i]); continue;}
+    if (!strcmp(argv[i], "-s") && i + 1 < argc) {rng = strtoul(argv[++i], 0, 10); if (!rng) rng = 1; continue;}
+    FILE* f = fopen(argv[i], "rb");
+    if (!f) {
+      printf("can't open %s\n", argv[i]);
+      return 2;
+    }
+    std::string content;
+    int c;
+    while ((c = fgetc(f)) != EOF) content += (char)c;
+    fclose(f);
+    size_t nl = content.find('\n');
+    if (nl == std::string::npos) continue;
+    std::string reply = content.substr(nl + 1);
+    if (!reply.empty() && reply[reply.size() - 1] == '\n') reply.erase(reply.size() - 1);
+    corpus.push_back(std::make_pair(content.substr(0, nl), reply));
+  }
+  if (corpus.empty()) {
+    printf("usage: %s corpus/*.txt [-i iterations] [-s seed]\n", argv[0]);
+    return 2;
+  }
+
+  for (size_t i = 0; i < corpus.size(); i++) {
+    check(corpus[i].first, corpus[i].second, "corpus");
+    for (long k = 0; k < iterations; k++) {
+      check(corpus[i].first, mutate(corpus[i].second), "mutation");
+    }
+  }
+  static const int edge[] = {0, 1, -1, 9, 10, -10, 32767, -32768, 999999, 1000000, -1000000, INT_MAX, INT_MIN, INT_MIN + 1};
+  const byte nEdge = sizeof(edge) / sizeof(edge[0]);
+  for (byte i = 0; i < nEdge; i++) {
+    checkFormat(edge + i, 1, "format");
+  }
+  checkFormat(edge, nEdge, "format");
+  for (long k = 0; k < iterations; k++) {
+    int args[4];
+    for (byte i = 0; i < 4; i++) {
+      args[i] = (int)nextRandom() >> (nextRandom() % 32);
+    }
+    checkFormat(args, 1 + nextRandom() % 4, "format");
+  }
+  printf("%d corpus entries, %ld mutations each, %lu failures\n", (int)corpus.size(), iterations, failures);
+  return failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,334 @@
+/*
+  replay.cpp - Feeds a capture of ArdoxyCapture back through the library with the recorded reply timing.
+
+  Build and run (from this directory):
+    g++ -std=c++11 -Wall -Wextra -O2 -I. -I../.. replay.cpp HostArduino.cpp ../../Ardoxy*.cpp -o ardoxy_replay
+    ./ardoxy_replay [-t timeout_ms] [-s session] CAPTURE.BIN > replay.csv
+    ./ardoxy_replay -d CAPTURE.BIN            (list the records)
+
+  Every command of the capture is sent again through Ardoxy::startMeasure() / startReadout() and poll().
+  The replay port answers each command with the bytes that followed it in the capture, at the same time
+  after the command as recorded, and keeps the recorded pauses between commands. Parser, timeout and
+  resync changes can thus be tested against real sessions from the field. Each command is checked with the
+  recorded timeout (unless -t is given) and number of values its reply must contain.
+
+  Output (CSV, one row per command): time of the command [ms], command, result (1 ok, 0 no reply, 9 mismatch),
+  values after the echo (recorded), last value (as parsed by the library), reply time in the replay [ms], reply time in the capture [ms] (time to
+  the end marker, empty if none was recorded). The communication statistics of each session follow on stderr.
+*/
+
+#include "Arduino.h"
+#include <Ardoxy.h>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+struct Record
+{
+  int tag;                                    // ARDOXY_CAPTURE_*, or the number of bytes (| ARDOXY_CAPTURE_TX if sent)
+  unsigned long long at;                      // µs since the start of the session
+  unsigned long baud;                         // ARDOXY_CAPTURE_OPEN
+  unsigned long timeout;                      // sent: reply timeout [ms]
+  int minValues;                              // sent: values the reply must contain
+  std::string data;
+};
+
+typedef std::vector<Record> Session;
+
+// Print to stderr, for Ardoxy::printStats()
+struct ErrPrint : public Print
+{
+  size_t write(uint8_t c) {return fputc(c, stderr) != EOF;}
+  using Print::write;
+};
+
+static bool isSent(const Record& r)
+{
+  return r.tag > ARDOXY_CAPTURE_START;
+}
+
+static bool isReceived(const Record& r)
+{
+  return r.tag > ARDOXY_CAPTURE_OPEN && r.tag < ARDOXY_CAPTURE_START;
+}
+
+// Split a capture file into sessions (one per ArdoxyCapture::begin())
+static bool readCapture(FILE* f, std::vector<Session>& sessions)
+{
+  int c;
+  unsigned long long at = 0;
+  while ((c = fgetc(f)) != EOF) {
+    Record r;
+    r.tag = c;
+    r.baud = 0;
+    r.timeout = 0;
+    r.minValues = 0;
+    if (c == ARDOXY_CAPTURE_START) {
+      unsigned char h[7];
+      if (fread(h, 1, 7, f) != 7 || h[0] != 'A' || h[1] != 'X' || h[2] != ARDOXY_CAPTURE_VERSION) {
+        fprintf(stderr, "unknown capture format at byte %ld\n", ftell(f));
+        return false;
+      }
+      sessions.push_back(Session());
+      at = 0;
+      continue;
+    }
+    if (sessions.empty()) {
+      fprintf(stderr, "capture does not start with a start record\n");
+      return false;
+    }
+    unsigned long long delta = 0;
+    int shift = 0;
+    int b;
+    do {
+      if ((b = fgetc(f)) == EOF) {
+        fprintf(stderr, "capture ends within a record\n");
+        return true;
+      }
+      delta |= (unsigned long long)(b & 0x7F) << shift;
+      shift += 7;
+    } while (b & 0x80);
+    at += delta;
+    r.at = at;
+    if (c == ARDOXY_CAPTURE_OPEN) {
+      shift = 0;
+      do {
+        if ((b = fgetc(f)) == EOF) return true;
+        r.baud |= (unsigned long)(b & 0x7F) << shift;
+        shift += 7;
+      } while (b & 0x80);
+    } else {
+      if (c & ARDOXY_CAPTURE_TX) {
+        shift = 0;
+        do {
+          if ((b = fgetc(f)) == EOF) return true;
+          r.timeout |= (unsigned long)(b & 0x7F) << shift;
+          shift += 7;
+        } while (b & 0x80);
+        if ((r.minValues = fgetc(f)) == EOF) return true;
+      }
+      int n = c & 0x7F;
+      r.data.resize(n);
+      if ((int)fread(&r.data[0], 1, n, f) != n) {
+        fprintf(stderr, "capture ends within a record\n");
+        return true;
+      }
+    }
+    sessions.back().push_back(r);
+  }
+  return true;
+}
+
+static void printEscaped(const std::string& s)
+{
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char ch = s[i];
+    if (ch == '\r') printf("\\r");
+    else if (ch >= 32 && ch < 127) putchar(ch);
+    else printf("\\x%02X", ch);
+  }
+}
+
+// Serial port that answers the commands of the library with the recorded replies
+class ReplayPort : public HardwareSerial
+{
+  public:
+    ReplayPort(const Session& s) : session(s) {}
+    int available()
+    {
+      unsigned long long now = hostMicros();
+      int n = 0;
+      for (size_t i = 0; i < rx.size() && rx[i].first <= now; i++) n++;
+      return n;
+    }
+    int read()
+    {
+      if (!available()) return -1;
+      char c = rx.front().second;
+      rx.pop_front();
+      return (uint8_t)c;
+    }
+    int peek()
+    {
+      return available() ? (uint8_t)rx.front().second : -1;
+    }
+    size_t write(uint8_t c)
+    {
+      line += (char)c;
+      if (c == '\r') {
+        answer(line);
+        line.clear();
+      }
+      return 1;
+    }
+    using Print::write;
+
+    // Bytes received before the first command (e.g. a reply still on its way after a reset)
+    void start(size_t first)
+    {
+      base = hostMicros();
+      for (size_t i = 0; i < first; i++) {
+        schedule(session[i], base + session[i].at);
+      }
+      next = first;
+    }
+
+    unsigned long diverged = 0;               // commands that differ from the recorded one
+    unsigned long long sentAt = 0;            // time the last command was completely written
+
+  private:
+    // Queue the records that followed the recorded command, relative to the time the command is sent now
+    void answer(const std::string& cmd)
+    {
+      while (next < session.size() && !isSent(session[next])) next++;
+      if (next >= session.size()) return;     // more commands than recorded: no reply
+      const Record& tx = session[next];
+      if (tx.data != cmd) diverged++;
+      unsigned long long now = hostMicros();
+      sentAt = now;
+      for (next++; next < session.size() && !isSent(session[next]); next++) {
+        schedule(session[next], now + (session[next].at - tx.at));
+      }
+    }
+
+    void schedule(const Record& r, unsigned long long at)
+    {
+      if (!isReceived(r)) return;
+      if (!rx.empty() && at < rx.back().first) at = rx.back().first;
+      for (size_t i = 0; i < r.data.size(); i++) {
+        rx.push_back(std::make_pair(at, r.data[i]));
+      }
+    }
+
+    const Session& session;
+    size_t next = 0;
+    unsigned long long base = 0;
+    std::string line;
+    std::deque<std::pair<unsigned long long, char> > rx;
+};
+
+// Number of values after the echo of a recorded reply
+static int countValues(const std::string& reply, size_t echoLength)
+{
+  int n = 0;
+  size_t pos = reply.find(' ', echoLength);
+  while (pos != std::string::npos) {
+    n++;
+    pos = reply.find(' ', pos + 1);
+  }
+  return n;
+}
+
+static void dump(const Session& s)
+{
+  for (size_t i = 0; i < s.size(); i++) {
+    printf("%12.3f ", s[i].at / 1000.0);
+    if (s[i].tag == ARDOXY_CAPTURE_OPEN) {
+      printf("open %lu baud\n", s[i].baud);
+      continue;
+    }
+    printf(isSent(s[i]) ? "> " : "< ");
+    printEscaped(s[i].data);
+    if (isSent(s[i])) printf("  (timeout %lu ms, %d values)", s[i].timeout, s[i].minValues);
+    putchar('\n');
+  }
+}
+
+static void replay(const Session& s, int timeout)
+{
+  ReplayPort port(s);
+  Ardoxy ardoxy((Stream&)port);
+  size_t first = 0;
+  while (first < s.size() && !isSent(s[first])) first++;
+  port.start(first);
+  unsigned long long base = hostMicros();
+  unsigned long long prevSent = base;                     // replay time of the last command
+  unsigned long long prevAt = 0;                          // capture time of the last command
+  int counts[10] = {};
+
+  for (size_t i = first; i < s.size(); i++) {
+    if (!isSent(s[i])) continue;
+    // keep the recorded pause after the last command, the same reference as the replies are scheduled to
+    unsigned long long due = prevSent + (s[i].at - prevAt);
+    if (hostMicros() < due) hostAdvance(due - hostMicros());
+
+    std::string cmd = s[i].data;
+    if (cmd.empty() || cmd[cmd.size() - 1] != '\r') cmd += '\r';
+    int t = timeout > 0 ? timeout : (int)s[i].timeout;
+    unsigned long long sentAt = hostMicros();
+    if (s[i].minValues > 0) ardoxy.startReadout(cmd.c_str(), t);
+    else ardoxy.startMeasure(cmd.c_str(), t);
+    prevSent = port.sentAt;
+    prevAt = s[i].at;
+    while (!ardoxy.poll()) yield();
+    double ms = (hostMicros() - sentAt) / 1000.0;
+
+    // reply time in the capture: up to the first end marker after the command
+    std::string reply;
+    double recorded = -1;
+    for (size_t j = i + 1; j < s.size() && !isSent(s[j]) && recorded < 0; j++) {
+      if (!isReceived(s[j])) continue;
+      size_t end = s[j].data.find('\r');
+      reply += s[j].data.substr(0, end);
+      if (end != std::string::npos) recorded = (s[j].at - s[i].at) / 1000.0;
+    }
+    int values = countValues(reply, cmd.size() - 1);
+    int result = ardoxy.result();
+    if (result == 1 && values < s[i].minValues) {
+      result = 9;                             // e.g. a measure-and-read whose reply lacks registers
+    }
+    counts[result < 10 ? result : 0]++;
+
+    printf("%.3f;", (sentAt - base) / 1000.0);
+    printEscaped(cmd.substr(0, cmd.size() - 1));
+    printf(";%d;%d;%ld;%.3f;", result, result == 1 ? values : 0, ardoxy.value(), ms);
+    if (recorded >= 0) printf("%.3f", recorded);
+    putchar('\n');
+  }
+  fprintf(stderr, "ok %d, no reply %d, mismatch %d, diverged commands %lu\n", counts[1], counts[0], counts[9], port.diverged);
+  ErrPrint err;
+  ardoxy.printStats(err);
+}
+
+int main(int argc, char** argv)
+{
+  int timeout = 0;
+  int only = -1;
+  bool list = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:s:d")) != -1) {
+    switch (opt) {
+      case 't': timeout = atoi(optarg); break;
+      case 's': only = atoi(optarg); break;
+      case 'd': list = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-t timeout_ms] [-s session] [-d] CAPTURE.BIN\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: %s [-t timeout_ms] [-s session] [-d] CAPTURE.BIN\n", argv[0]);
+    return 1;
+  }
+  FILE* f = fopen(argv[optind], "rb");
+  if (!f) {
+    perror(argv[optind]);
+    return 1;
+  }
+  std::vector<Session> sessions;
+  bool ok = readCapture(f, sessions);
+  fclose(f);
+  if (!ok) return 1;
+
+  Serial.quiet = true;
+  if (!list) printf("time_ms;command;result;values;last;reply_ms;recorded_ms\n");
+  for (size_t k = 0; k < sessions.size(); k++) {
+    if (only >= 0 && (int)k != only) continue;
+    fprintf(stderr, "session %u: %u records\n", (unsigned)k, (unsigned)sessions[k].size());
+    if (list) dump(sessions[k]);
+    else replay(sessions[k], timeout);
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+/*
+  telemetry_decode.cpp - Converts the binary telemetry frames of ArdoxyTelemetry to CSV or plotter lines.
+
+  Build and run (from this directory):
+    g++ -std=c++11 -Wall -Wextra -O2 telemetry_decode.cpp -o ardoxy_telemetry_decode
+    ./ardoxy_telemetry_decode [-s scales] [-p] [FILE] > telemetry.csv
+
+  Reads the frames from FILE or stdin, e.g. a serial port in raw mode:
+    stty -F /dev/ttyACM0 19200 raw && ./ardoxy_telemetry_decode -s 100,100,1 /dev/ttyACM0
+
+  Output (one line per frame, flushed, so it can be piped into a plotter):
+    default: sequence;millis;value1;value2;...
+    -p:      value1;value2;... (the ASCII format of the SerialPlot configuration in this repository)
+  -s divides the values by the given scales (comma-separated, per column, the last one repeats),
+  e.g. 100 for DO and temperature sent with ArdoxyTelemetry::centi().
+  Missing values (ARDOXY_TELEMETRY_NONE) are left empty. Text between frames (e.g. the start-up or error
+  messages of a sketch) is copied to stderr. Frames with a wrong CRC or length are dropped; dropped frames,
+  gaps in the sequence numbers and the bytes read are reported on stderr at the end.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#define MAX_VALUES 64
+#define MAX_FRAME (7 + 2 * MAX_VALUES + 2)
+#define NONE -32768
+
+// Text printed by the sketch ends with a line break and holds no control characters
+static bool isText(const unsigned char* p, int length)
+{
+  if (p[length - 1] != '\n') {
+    return false;
+  }
+  for (int i = 0; i < length; i++) {
+    if (p[i] < 0x20 && p[i] != '\r' && p[i] != '\n' && p[i] != '\t') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static unsigned int crc16(const unsigned char* data, int length)
+{
+  unsigned int crc = 0xFFFF;
+  for (int i = 0; i < length; i++) {
+    crc ^= (unsigned int)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc & 0xFFFF;
+}
+
+// Returns the decoded length, -1 if the encoding is invalid
+static int cobsDecode(const unsigned char* in, int length, unsigned char* out)
+{
+  int pos = 0, n = 0;
+  while (pos < length) {
+    int code = in[pos++];
+    if (code == 0 || pos + code - 1 > length) {
+      return -1;
+    }
+    for (int i = 1; i < code; i++) {
+      out[n++] = in[pos++];
+    }
+    if (code < 0xFF && pos < length) {
+      out[n++] = 0;
+    }
+  }
+  return n;
+}
+
+int main(int argc, char** argv)
+{
+  double scales[MAX_VALUES];
+  int nScales = 0;
+  bool plot = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:p")) != -1) {
+    switch (opt) {
+      case 's':
+        for (char* tok = strtok(optarg, ","); tok && nScales < MAX_VALUES; tok = strtok(0, ",")) {
+          scales[nScales] = atof(tok);
+          if (scales[nScales] == 0) scales[nScales] = 1;
+          nScales++;
+        }
+        break;
+      case 'p': plot = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-s scales] [-p] [FILE]\n", argv[0]);
+        return 2;
+    }
+  }
+  FILE* f = stdin;
+  if (optind < argc) {
+    f = fopen(argv[optind], "rb");
+    if (!f) {
+      fprintf(stderr, "can't open %s\n", argv[optind]);
+      return 2;
+    }
+  }
+
+  unsigned char raw[2 * MAX_FRAME], frame[2 * MAX_FRAME];
+  int len = 0;
+  bool overflow = false;
+  unsigned long bytes = 0, frames = 0, dropped = 0, lost = 0;
+  long lastSeq = -1;
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    bytes++;
+    if (c != 0) {
+      if (len < (int)sizeof(raw)) raw[len++] = c;
+      else overflow = true;
+      continue;
+    }
+    if (len == 0) {                                                         // delimiter before a frame
+      continue;
+    }
+    if (isText(raw, len)) {
+      fwrite(raw, 1, len, stderr);
+      len = 0;
+      overflow = false;
+      continue;
+    }
+    int n = overflow ? -1 : cobsDecode(raw, len, frame);
+    len = 0;
+    overflow = false;
+    if (n < 9 || n != 9 + 2 * frame[6] || crc16(frame, n - 2) != (unsigned)(frame[n - 2] | (frame[n - 1] << 8))) {
+      dropped++;
+      continue;
+    }
+    frames++;
+    unsigned int seq = frame[0] | (frame[1] << 8);
+    unsigned long ms = frame[2] | (frame[3] << 8) | ((unsigned long)frame[4] << 16) | ((unsigned long)frame[5] << 24);
+    if (lastSeq >= 0) {
+      lost += (seq - lastSeq - 1) & 0xFFFF;
+    }
+    lastSeq = seq;
+    if (!plot) {
+      printf("%u;%lu", seq, ms);
+    }
+    for (int k = 0; k < frame[6]; k++) {
+      short v = frame[7 + 2 * k] | (frame[8 + 2 * k] << 8);
+      double scale = nScales ? scales[k < nScales ? k : nScales - 1] : 1;
+      if (!plot || k > 0) putchar(';');
+      if (v != NONE) printf("%g", v / scale);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+  if (f != stdin) {
+    fclose(f);
+  }
+  fprintf(stderr, "%lu bytes, %lu frames, %lu dropped (CRC or length), %lu lost (sequence gaps)\n", bytes, frames, dropped, lost);
+  return 0;
+}